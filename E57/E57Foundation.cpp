@@ -2780,12 +2780,18 @@ This function may be called at any time (as long as ImageFile and CompressedVect
 The next read will start at the given recordNumber.
 It is not an error to seek to recordNumber = childCount() (i.e. to one record past end of CompressedVectorNode).
 
+The records before @a recordNumber are not decoded.
+If the binary section has index packets, they are used to find the chunk holding the record.
+Otherwise the data packet headers are scanned, once per CompressedVectorReader, and remembered for later seeks.
+Seeking is not possible when a field is a string (records of variable length).
+
 @pre     @a recordNumber <= childCount() of CompressedVectorNode.
 @pre     The associated ImageFile must be open.
 @pre     This CompressedVectorReader must be open (i.e isOpen())
 @throw   ::E57_ERROR_BAD_API_ARGUMENT
 @throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
 @throw   ::E57_ERROR_READER_NOT_OPEN
+@throw   ::E57_ERROR_NOT_IMPLEMENTED    A field is a string
 @throw   ::E57_ERROR_BAD_CV_PACKET
 @throw   ::E57_ERROR_LSEEK_FAILED
 @throw   ::E57_ERROR_READ_FAILED
@@ -2844,6 +2850,27 @@ CompressedVectorNode CompressedVectorReader::compressedVectorNode() const
     CHECK_INVARIANCE_RETURN(CompressedVectorNode, impl_->compressedVectorNode());
 }
 
+/*================*/ /*!
+@brief   Get the packet cache counters of this CompressedVectorReader.
+@param   [out] hits     The number of binary section packet lookups that were satisfied from the cache.
+@param   [out] misses   The number of lookups that had to read the packet from the file.
+@param   [out] rereads  The number of those misses that read a packet that had been read before, and evicted.
+@details
+A high @a rereads count means the cache is too small for the number of fields being read, see the @c cache setting of ImageFile::ImageFile.
+@pre     The associated ImageFile must be open.
+@pre     This CompressedVectorReader must be open (i.e isOpen())
+@post    No visible state is modified.
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_READER_NOT_OPEN
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     ImageFile::ImageFile, ImageFile::checksumStatistics
+*/ /*================*/
+void CompressedVectorReader::cacheStatistics(uint64_t& hits, uint64_t& misses, uint64_t& rereads) const
+{
+    impl_->cacheStatistics(hits, misses, rereads);
+    CHECK_THIS_INVARIANCE()
+}
+
 //! @brief   Diagnostic function to print internal state of object to output stream in an indented format.
 //! @copydetails Node::dump()
 #ifdef E57_DEBUG
@@ -2982,6 +3009,66 @@ void CompressedVectorWriter::write(std::vector<SourceDestBuffer>& sbufs, const s
     CHECK_THIS_INVARIANCE()
 }
 
+/*================*/ /*!
+@brief   Start transfer of block of data to CompressedVectorNode from given source buffers, and return without waiting for it to finish.
+@param   [in] sbufs         Vector of memory buffers that hold data to be written to a CompressedVectorNode.
+@param   [in] recordCount   Number of records to write.
+@details
+The records are encoded and written to the file on a background thread, while the caller goes on.
+Only one such write runs at a time: if the previous one hasn't finished, this function waits for it first.
+So a producer can double buffer, filling one set of buffers while the records of the other are written:
+@code
+    writer.writeAsync(sbufsA, countA);   // returns at once, writer owns the memory of sbufsA
+    ... fill the memory of sbufsB ...
+    writer.writeAsync(sbufsB, countB);   // waits for sbufsA to be written, then hands over sbufsB
+    ... fill the memory of sbufsA again ...
+    writer.waitForWrite();               // sbufsB done, writer owns no buffer memory
+@endcode
+
+The memory of @a sbufs belongs to this CompressedVectorWriter until the next call to CompressedVectorWriter::writeAsync, CompressedVectorWriter::write, CompressedVectorWriter::waitForWrite or CompressedVectorWriter::close returns: the caller must not change or free it before then.
+The requirements on @a sbufs are those of CompressedVectorWriter::write(std::vector<SourceDestBuffer>&, unsigned), and are checked before this function returns.
+An error during the transfer itself is thrown by the next call to CompressedVectorWriter::writeAsync, CompressedVectorWriter::write, CompressedVectorWriter::waitForWrite or CompressedVectorWriter::close, and leaves objects in the state documented for CompressedVectorWriter::write.
+While a write is in progress, the associated ImageFile must not be closed.
+BlobNode::write to a BlobNode of the associated ImageFile may be called meanwhile: it waits for the write in progress to finish, as the two share the file.
+
+@pre     The associated ImageFile must be open.
+@pre     This CompressedVectorWriter must be open (i.e isOpen())
+@throw   ::E57_ERROR_BAD_API_ARGUMENT
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_WRITER_NOT_OPEN
+@throw   ::E57_ERROR_PATH_UNDEFINED
+@throw   ::E57_ERROR_NO_BUFFER_FOR_ELEMENT
+@throw   ::E57_ERROR_BUFFER_SIZE_MISMATCH
+@throw   ::E57_ERROR_BUFFER_DUPLICATE_PATHNAME
+@throw   ::E57_ERROR_BUFFERS_NOT_COMPATIBLE
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@throw   any error of the previous write, see CompressedVectorWriter::write(std::vector<SourceDestBuffer>&, unsigned)
+@see     CompressedVectorWriter::waitForWrite, CompressedVectorWriter::write(std::vector<SourceDestBuffer>&,unsigned), CompressedVectorWriter::close
+*/ /*================*/
+void CompressedVectorWriter::writeAsync(std::vector<SourceDestBuffer>& sbufs, const size_t recordCount)
+{
+    CHECK_THIS_INVARIANCE()
+    impl_->writeAsync(sbufs, recordCount);
+    CHECK_THIS_INVARIANCE()
+}
+
+/*================*/ /*!
+@brief   Wait for the write started by CompressedVectorWriter::writeAsync to finish.
+@details
+On return, the caller owns the memory of all buffers given to CompressedVectorWriter::writeAsync again.
+Does nothing if no write is in progress.
+Records written are encoded, but may not be in the file until CompressedVectorWriter::close.
+@pre     The associated ImageFile must be open.
+@throw   any error of the write, see CompressedVectorWriter::write(std::vector<SourceDestBuffer>&, unsigned)
+@see     CompressedVectorWriter::writeAsync
+*/ /*================*/
+void CompressedVectorWriter::waitForWrite()
+{
+    CHECK_THIS_INVARIANCE()
+    impl_->waitForWrite();
+    CHECK_THIS_INVARIANCE()
+}
+
 /*================*/ /*!
 @brief   End the write operation.
 @details
@@ -2989,6 +3076,7 @@ This function must be called to safely and gracefully end a transfer to a Compre
 This is required because errors cannot be communicated from the CompressedVectorNode destructor (in C++ destructors can't throw exceptions).
 It is not an error to call this function if the CompressedVectorWriter is already closed.
 This function will cause the CompressedVectorWriter to enter the closed state, and any further transfers requests will fail.
+A transfer started by CompressedVectorWriter::writeAsync is waited for first, and an error in it is thrown by this function.
 
 @b Warning: If this function is not called before the CompressedVectorWriter destructor is invoked, all writes to the CompressedVectorNode will be lost (it will have zero children).
 @pre     The associated ImageFile must be open.
@@ -3317,15 +3405,18 @@ CompressedVectorWriter CompressedVectorNode::writer(std::vector<SourceDestBuffer
 The pathNames in the @a dbufs must identify terminal nodes (i.e. node that can have no children: IntegerNode, ScaledIntegerNode, FloatNode, StringNode) in this CompressedVectorNode's prototype.
 It is an error for two SourceDestBuffers in @a dbufs to identify the same terminal node in the prototype.
 It is not an error to create a CompressedVectorReader for an empty CompressedVectorNode.
+If the ImageFile was opened in read mode, any number of CompressedVectorReaders may be open at once, and they may be used from different threads (see ImageFile::readConcurrently).
 
 @pre     @a dbufs can't be empty
 @pre     The destination ImageFile must be open (i.e. destImageFile().isOpen()).
 @pre     The destination ImageFile can't have any writers open (destImageFile().writerCount()==0)
+@pre     If the destination ImageFile was opened in write mode, it can't have any readers open (destImageFile().readerCount()==0)
 @pre     This CompressedVectorNode must be attached (i.e. isAttached()).
 @return  A smart CompressedVectorReader handle referencing the underlying iterator object.
 @throw   ::E57_ERROR_BAD_API_ARGUMENT
 @throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
 @throw   ::E57_ERROR_TOO_MANY_WRITERS
+@throw   ::E57_ERROR_TOO_MANY_READERS
 @throw   ::E57_ERROR_NODE_UNATTACHED
 @throw   ::E57_ERROR_PATH_UNDEFINED
 @throw   ::E57_ERROR_BUFFER_SIZE_MISMATCH
@@ -4288,6 +4379,7 @@ See the class discussion at bottom of BlobNode page for more details.
 The E57 Foundation Implementation may pre-allocate disk space in the ImageFile to store the declared length of the blob.
 The disk must have enough free space to store @a byteCount bytes of data.
 The data of a newly created BlobNode is initialized to zero.
+Its space follows the binary sections already in the ImageFile, so it can't be created while a CompressedVectorWriter of the ImageFile is open.
 
 The @a destImageFile indicates which ImageFile the BlobNode will eventually be attached to.
 A node is attached to an ImageFile by adding it underneath the predefined root of the ImageFile (gotten from ImageFile::root).
@@ -4296,10 +4388,12 @@ It is an error to attempt to attach the BlobNode to a different ImageFile.
 @pre     The @a destImageFile must be open (i.e. destImageFile.isOpen() must be true).
 @pre     The @a destImageFile must have been opened in write mode (i.e. destImageFile.isWritable() must be true).
 @pre     byteCount >= 0
+@pre     The @a destImageFile must not have an open CompressedVectorWriter (i.e. destImageFile.writerCount() must be 0).
 @return  A smart BlobNode handle referencing the underlying object.
 @throw   ::E57_ERROR_BAD_API_ARGUMENT
 @throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
 @throw   ::E57_ERROR_FILE_IS_READ_ONLY
+@throw   ::E57_ERROR_TOO_MANY_WRITERS
 @throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
 @see     BlobCreate.cpp example, Node, BlobNode::read, BlobNode::write
 */ /*================*/
@@ -4567,7 +4661,28 @@ It is recommended that files that meet all of the requirements for a legal ASTM
 It is recommended that files that utilize the low-level E57 element data types, but do not have all the required element names required by ASTM E57 file format standard use the file extension @c "._e57".
 @param   [in] mode Either "w" for writing or "r" for reading.
 @param   [in] configuration A string that modifies the configuration of the E57 API implementation at run-time.
-Currently, in the reference implementation, this parameter is ignored.
+It is a list of name=value settings separated by spaces, commas or semicolons, e.g. "mmap=on checksum=headers".
+Recognized settings:
+    - mmap=on|off  In read mode, access the file through a memory mapping rather than a seek and read per page (default off).
+If the file can't be mapped, the normal read path is used.
+    - checksum=all|headers|none|N%  Which page checksums are verified when reading (default all).
+@c headers verifies the XML section and binary section and packet headers, but not the point data or blob bytes.
+@c N% verifies the headers and a pseudo-random N percent of the point data and blob pages.
+Skipping verification trades detection of file corruption for read speed, see ImageFile::checksumStatistics.
+    - threads=N|auto  Number of threads a CompressedVectorReader uses to decode the fields of its records (default 1).
+@c auto uses one thread per processor core.
+Extra threads only help when more than one field is read at once.
+    - encodeThreads=N|auto  In write mode, number of threads a CompressedVectorWriter uses to encode the fields of its records (default 1).
+The file written is the same, byte for byte, whatever the number of threads.
+Writers of records with a string field always encode on one thread.
+    - prefetch=N  In read mode, number of binary section packets a CompressedVectorReader reads ahead on a background thread (default 0, off).
+Read ahead overlaps file reads and checksum verification with decoding.
+    - cache=N  Number of binary section packets held in memory by each CompressedVectorReader.
+The default is sized from the number of fields read, see CompressedVectorReader::cacheStatistics.
+    - index=N  In write mode, number of records per chunk of the index each CompressedVectorWriter writes after its data (default 65536, rounded up to a multiple of 64).
+The index lets CompressedVectorReader::seek find a record by reading a few packets, instead of every data packet header before it.
+@c index=0 writes no index.
+An unrecognized setting or value causes ::E57_ERROR_BAD_CONFIGURATION.
 @details
 
 @par Write Mode
@@ -4743,6 +4858,55 @@ int ImageFile::readerCount() const
     CHECK_INVARIANCE_RETURN(int, impl_->readerCount());
 }
 
+/*================*/ /*!
+@brief   Get the number of file pages read so far, and how many of them had their checksum verified.
+@param   [out] pagesRead     The number of 1024 byte pages passed through reads of the ImageFile since it was opened.
+@param   [out] pagesChecked  The number of those pages whose checksum was verified.
+@details
+The proportion of pages checked depends on the @c checksum setting of the configuration string given to ImageFile::ImageFile.
+@pre     This ImageFile must be open (i.e. isOpen()).
+@post    No visible state is modified.
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     ImageFile::ImageFile
+*/ /*================*/
+void ImageFile::checksumStatistics(uint64_t& pagesRead, uint64_t& pagesChecked) const
+{
+    impl_->checksumStatistics(pagesRead, pagesChecked);
+    CHECK_THIS_INVARIANCE()
+}
+
+/*================*/ /*!
+@brief   Run a set of read jobs against a read mode ImageFile at the same time, on a pool of threads.
+@param   [in] tasks         The jobs to run. Each is typically the reading of one whole CompressedVector (e.g. one scan).
+@param   [in] threadCount   The number of threads to run jobs on, the calling thread being one of them. Zero means one per processor core.
+@param   [in] memoryLimit   The most memory, in bytes, that the jobs in progress at any one time may hold. Zero means no limit.
+@details
+Jobs are started in order, each as soon as a thread is free and its memory fits in @a memoryLimit alongside the jobs already in progress.
+The memory of a job is its ReadTask::memoryEstimate, plus the packet cache, read ahead and parallel decoding buffers of the CompressedVectorReader it opens.
+These are sized as the reader sizes them, from the configuration given to ImageFile::ImageFile and the ReadTask::channelCount of the job.
+A job that doesn't give its channelCount is charged the packet cache of a typical scan, which understates a reader of many fields.
+A job bigger than @a memoryLimit is still run, but only when no other job is in progress.
+
+While jobs are running, each may navigate the metadata tree, create SourceDestBuffers, and create, read and close CompressedVectorReaders of its own.
+Every reader has its own packet cache, and the binary sections are read with positioned reads that don't share a file cursor, so readers on different threads don't interfere.
+The jobs must not modify the ImageFile, and the caller must not use the ImageFile from other threads until this function returns.
+A CompressedVectorReader configured with more than one decoding thread (the @c threads setting) uses those in addition to @a threadCount.
+
+If a job throws an exception, the other jobs still run to completion, and then the first exception thrown is rethrown by this function.
+@pre     This ImageFile must be open (i.e. isOpen()), and opened in read mode.
+@post    No visible state is modified.
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_BAD_API_ARGUMENT   This ImageFile was opened in write mode.
+@throw   Any exception thrown by a job.
+@see     ImageFile::ImageFile, CompressedVectorNode::reader
+*/ /*================*/
+void ImageFile::readConcurrently(const std::vector<ReadTask>& tasks, unsigned threadCount, uint64_t memoryLimit)
+{
+    impl_->readConcurrently(tasks, threadCount, memoryLimit);
+    CHECK_THIS_INVARIANCE()
+}
+
 /*================*/ /*!
 @brief   Declare the use of an E57 extension in an ImageFile being written.
 @param   [in] prefix    The shorthand name of the extension to use in element names.
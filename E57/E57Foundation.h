@@ -41,6 +41,7 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <functional>
 #include <float.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
@@ -342,6 +343,7 @@ public:
     void        close();
     bool        isOpen();
     CompressedVectorNode compressedVectorNode() const;
+    void        cacheStatistics(uint64_t& hits, uint64_t& misses, uint64_t& rereads) const;
 
     void        dump(int indent = 0, std::ostream& os = std::cout) const;
     void        checkInvariant(bool doRecurse = true);
@@ -362,6 +364,8 @@ class CompressedVectorWriter {
 public:
     void        write(const size_t requestedRecordCount);
     void        write(std::vector<SourceDestBuffer>& sbufs, const size_t requestedRecordCount);
+    void        writeAsync(std::vector<SourceDestBuffer>& sbufs, const size_t requestedRecordCount);
+    void        waitForWrite();
     void        close();
     bool        isOpen();
     CompressedVectorNode compressedVectorNode() const;
@@ -615,6 +619,16 @@ protected: //=================
 //! \endcond
 };
 
+//! @brief One job for ImageFile::readConcurrently, typically reading a whole CompressedVector
+struct ReadTask {
+    std::function<void ()> run;             //!< Called once, on one of the reading threads
+    uint64_t        memoryEstimate;         //!< Bytes that run holds while in progress, e.g. for its SourceDestBuffer arrays
+    unsigned        channelCount;           //!< Most SourceDestBuffers given to the CompressedVectorReader run opens, 0 if not known
+                    ReadTask() : memoryEstimate(0), channelCount(0) {};
+                    ReadTask(const std::function<void ()>& run0, uint64_t memoryEstimate0 = 0, unsigned channelCount0 = 0)
+                        : run(run0), memoryEstimate(memoryEstimate0), channelCount(channelCount0) {};
+};
+
 class ImageFile {
 public:
                     ImageFile(const ustring& fname, const ustring& mode, const ustring& configuration = "");
@@ -626,6 +640,8 @@ public:
     ustring         fileName() const;
     int             writerCount() const;
     int             readerCount() const;
+    void            checksumStatistics(uint64_t& pagesRead, uint64_t& pagesChecked) const;
+    void            readConcurrently(const std::vector<ReadTask>& tasks, unsigned threadCount = 0, uint64_t memoryLimit = 0);
 
     // Manipulate registered extensions in the file
     void            extensionsAdd(const ustring& prefix, const ustring& uri);
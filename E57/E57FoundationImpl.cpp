@@ -54,6 +54,7 @@
 #  include <sys/types.h>
 #  include <sys/stat.h>
 #  include <unistd.h>
+#  include <sys/mman.h>
 # include <fcntl.h>
 # define O_BINARY (0)
 # define _unlink unlink
@@ -62,11 +63,13 @@
 #endif
 
 #include <sstream>
-//#include <memory> //??? needed?
+#include <memory>
 #include <fstream> //??? needed?
 #include <iomanip> //??? needed?
 #include <cmath> //??? needed?
 #include <float.h> //??? needed?
+#include <climits>
+#include <limits>
 
 #ifdef E57_MAX_VERBOSE
 #include <iostream>
@@ -91,6 +94,9 @@ using std::string;
 using std::auto_ptr;
 using std::min;
 using std::max;
+using std::pair;
+using std::make_pair;
+using std::upper_bound;
 
 //using namespace boost;
 using boost::weak_ptr;
@@ -1759,6 +1765,655 @@ void SourceDestBufferImpl::setNextString(const ustring& value)
     nextIndex_++;
 }
 
+//=============================================================================
+// Bulk transfers
+
+namespace {
+
+/// Return the length of the leading run of values that lie within [lo, hi].
+/// The first pass is branch-free (and vectorizable), since out of range values are rare.
+/// Comparisons are written as in the per-value routines, so NaN counts as in range.
+template <typename V>
+size_t inRangeCount(const V* values, size_t count, V lo, V hi)
+{
+    bool bad = false;
+    for (size_t i = 0; i < count; i++)
+        bad |= (values[i] < lo) | (hi < values[i]);
+    if (!bad)
+        return(count);
+
+    size_t i = 0;
+    while (!(values[i] < lo || hi < values[i]))
+        i++;
+    return(i);
+}
+
+}
+
+void SourceDestBufferImpl::checkArrayRoom_(size_t count)
+{
+    /// Verify have room for (or have) all count elements, once for the whole transfer
+    if (count > capacity_ - nextIndex_)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "pathName=" + pathName_ + " count=" + toString(count));
+}
+
+template <typename T, typename V>
+void SourceDestBufferImpl::storeArray_(const V* values, size_t count)
+{
+    char* p = &base_[nextIndex_*stride_];
+
+    /// Contiguous buffers get a plain indexed loop the compiler can vectorize.
+    if (stride_ == sizeof(T)) {
+        T* outp = reinterpret_cast<T*>(p);
+        for (size_t i = 0; i < count; i++)
+            outp[i] = static_cast<T>(values[i]);
+    } else {
+        const size_t stride = stride_;
+        for (size_t i = 0; i < count; i++, p += stride)
+            *reinterpret_cast<T*>(p) = static_cast<T>(values[i]);
+    }
+    nextIndex_ += static_cast<unsigned>(count);
+}
+
+template <typename T, typename V>
+void SourceDestBufferImpl::storeArrayInRange_(const V* values, size_t count, V lo, V hi, ErrorCode ecode, const char* valueName)
+{
+    /// Store the values up to the first one that isn't representable, then fault on it (like the per-value routines).
+    size_t goodCount = inRangeCount(values, count, lo, hi);
+    storeArray_<T>(values, goodCount);
+    if (goodCount < count)
+        throw E57_EXCEPTION2(ecode, "pathName=" + pathName_ + " " + valueName + "=" + toString(values[goodCount]));
+}
+
+template <typename T, typename V>
+void SourceDestBufferImpl::loadArray_(V* values, size_t count)
+{
+    const char* p = &base_[nextIndex_*stride_];
+
+    if (stride_ == sizeof(T)) {
+        const T* inp = reinterpret_cast<const T*>(p);
+        for (size_t i = 0; i < count; i++)
+            values[i] = static_cast<V>(inp[i]);
+    } else {
+        const size_t stride = stride_;
+        for (size_t i = 0; i < count; i++, p += stride)
+            values[i] = static_cast<V>(*reinterpret_cast<const T*>(p));
+    }
+    nextIndex_ += static_cast<unsigned>(count);
+}
+
+void SourceDestBufferImpl::getNextInt64Array(int64_t* values, size_t count)
+{
+    /// don't checkImageFileOpen
+
+    checkArrayRoom_(count);
+
+    switch (memoryRepresentation_) {
+        case E57_INT8:   loadArray_<int8_t>(values, count);   break;
+        case E57_UINT8:  loadArray_<uint8_t>(values, count);  break;
+        case E57_INT16:  loadArray_<int16_t>(values, count);  break;
+        case E57_UINT16: loadArray_<uint16_t>(values, count); break;
+        case E57_INT32:  loadArray_<int32_t>(values, count);  break;
+        case E57_UINT32: loadArray_<uint32_t>(values, count); break;
+        case E57_INT64:  loadArray_<int64_t>(values, count);  break;
+        case E57_REAL32:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            //??? fault if get special value: NaN, NegInf...
+            loadArray_<float>(values, count);
+            break;
+        case E57_REAL64:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            //??? fault if get special value: NaN, NegInf...
+            loadArray_<double>(values, count);
+            break;
+        default:
+            /// E57_BOOL and E57_USTRING (and bad representations) go through the per-value routine, which handles them.
+            for (size_t i = 0; i < count; i++)
+                values[i] = getNextInt64();
+    }
+}
+
+void SourceDestBufferImpl::getNextInt64Array(int64_t* values, size_t count, double scale, double offset)
+{
+    /// don't checkImageFileOpen
+
+    /// If the user did not request scaling, then we get raw values from user's buffer.
+    if (!doScaling_) {
+        getNextInt64Array(values, count);
+        return;
+    }
+
+    /// Double check non-zero scale.  Going to divide by it below.
+    if (scale == 0)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "pathName=" + pathName_);
+
+    checkArrayRoom_(count);
+
+    switch (memoryRepresentation_) {
+        case E57_INT8: case E57_UINT8: case E57_INT16: case E57_UINT16:
+        case E57_INT32: case E57_UINT32: case E57_INT64:
+            break;
+        case E57_REAL32:
+        case E57_REAL64:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            //??? fault if get special value: NaN, NegInf...
+            break;
+        default:
+            for (size_t i = 0; i < count; i++)
+                values[i] = getNextInt64(scale, offset);
+            return;
+    }
+
+    /// Fetch a chunk into doubles, unscale and round in place, then check the whole chunk is representable in an int64_t.
+    double rawValues[arrayChunkSize];
+    for (size_t done = 0; done < count; ) {
+        size_t n = count - done;
+        if (n > arrayChunkSize)
+            n = arrayChunkSize;
+
+        switch (memoryRepresentation_) {
+            case E57_INT8:   loadArray_<int8_t>(rawValues, n);   break;
+            case E57_UINT8:  loadArray_<uint8_t>(rawValues, n);  break;
+            case E57_INT16:  loadArray_<int16_t>(rawValues, n);  break;
+            case E57_UINT16: loadArray_<uint16_t>(rawValues, n); break;
+            case E57_INT32:  loadArray_<int32_t>(rawValues, n);  break;
+            case E57_UINT32: loadArray_<uint32_t>(rawValues, n); break;
+            case E57_INT64:  loadArray_<int64_t>(rawValues, n);  break;
+            case E57_REAL32: loadArray_<float>(rawValues, n);    break;
+            default:         loadArray_<double>(rawValues, n);   break;
+        }
+        for (size_t i = 0; i < n; i++)
+            rawValues[i] = floor((rawValues[i] - offset)/scale + 0.5);
+
+        size_t goodCount = inRangeCount(rawValues, n, static_cast<double>(E57_INT64_MIN), static_cast<double>(E57_INT64_MAX));
+        for (size_t i = 0; i < goodCount; i++)
+            values[done + i] = static_cast<int64_t>(rawValues[i]);
+        if (goodCount < n) {
+            /// Leave the bad value as the next one to be read, as the per-value routine does.
+            nextIndex_ -= static_cast<unsigned>(n - goodCount);
+            throw E57_EXCEPTION2(E57_ERROR_SCALED_VALUE_NOT_REPRESENTABLE,
+                                 "pathName=" + pathName_
+                                 + " value=" + toString(rawValues[goodCount]));
+        }
+        done += n;
+    }
+}
+
+void SourceDestBufferImpl::getNextFloatArray(float* values, size_t count)
+{
+    /// don't checkImageFileOpen
+
+    checkArrayRoom_(count);
+
+    switch (memoryRepresentation_) {
+        case E57_INT8: case E57_UINT8: case E57_INT16: case E57_UINT16:
+        case E57_INT32: case E57_UINT32: case E57_INT64:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            break;
+        default:
+            break;
+    }
+
+    switch (memoryRepresentation_) {
+        case E57_INT8:   loadArray_<int8_t>(values, count);   break;
+        case E57_UINT8:  loadArray_<uint8_t>(values, count);  break;
+        case E57_INT16:  loadArray_<int16_t>(values, count);  break;
+        case E57_UINT16: loadArray_<uint16_t>(values, count); break;
+        case E57_INT32:  loadArray_<int32_t>(values, count);  break;
+        case E57_UINT32: loadArray_<uint32_t>(values, count); break;
+        case E57_INT64:  loadArray_<int64_t>(values, count);  break;
+        case E57_REAL32: loadArray_<float>(values, count);    break;
+        case E57_REAL64: {
+            /// Check that exponent of user's values is not too large for single precision number in file.
+            double d[arrayChunkSize];
+            for (size_t done = 0; done < count; ) {
+                size_t n = count - done;
+                if (n > arrayChunkSize)
+                    n = arrayChunkSize;
+                loadArray_<double>(d, n);
+
+                ///??? silently limit here?
+                size_t goodCount = inRangeCount(d, n, E57_DOUBLE_MIN, E57_DOUBLE_MAX);
+                for (size_t i = 0; i < goodCount; i++)
+                    values[done + i] = static_cast<float>(d[i]);
+                if (goodCount < n) {
+                    nextIndex_ -= static_cast<unsigned>(n - goodCount);
+                    throw E57_EXCEPTION2(E57_ERROR_REAL64_TOO_LARGE, "pathName=" + pathName_ + " value=" + toString(d[goodCount]));
+                }
+                done += n;
+            }
+            break;
+        }
+        default:
+            for (size_t i = 0; i < count; i++)
+                values[i] = getNextFloat();
+    }
+}
+
+void SourceDestBufferImpl::getNextDoubleArray(double* values, size_t count)
+{
+    /// don't checkImageFileOpen
+
+    checkArrayRoom_(count);
+
+    switch (memoryRepresentation_) {
+        case E57_INT8: case E57_UINT8: case E57_INT16: case E57_UINT16:
+        case E57_INT32: case E57_UINT32: case E57_INT64:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            break;
+        default:
+            break;
+    }
+
+    switch (memoryRepresentation_) {
+        case E57_INT8:   loadArray_<int8_t>(values, count);   break;
+        case E57_UINT8:  loadArray_<uint8_t>(values, count);  break;
+        case E57_INT16:  loadArray_<int16_t>(values, count);  break;
+        case E57_UINT16: loadArray_<uint16_t>(values, count); break;
+        case E57_INT32:  loadArray_<int32_t>(values, count);  break;
+        case E57_UINT32: loadArray_<uint32_t>(values, count); break;
+        case E57_INT64:  loadArray_<int64_t>(values, count);  break;
+        case E57_REAL32: loadArray_<float>(values, count);    break;
+        case E57_REAL64: loadArray_<double>(values, count);   break;
+        default:
+            for (size_t i = 0; i < count; i++)
+                values[i] = getNextDouble();
+    }
+}
+
+void SourceDestBufferImpl::setNextInt64Array(const int64_t* values, size_t count)
+{
+    /// don't checkImageFileOpen
+
+    checkArrayRoom_(count);
+
+    switch (memoryRepresentation_) {
+        case E57_INT8:
+            storeArrayInRange_<int8_t>(values, count, static_cast<int64_t>(E57_INT8_MIN), static_cast<int64_t>(E57_INT8_MAX),
+                                       E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT8:
+            storeArrayInRange_<uint8_t>(values, count, static_cast<int64_t>(E57_UINT8_MIN), static_cast<int64_t>(E57_UINT8_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT16:
+            storeArrayInRange_<int16_t>(values, count, static_cast<int64_t>(E57_INT16_MIN), static_cast<int64_t>(E57_INT16_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT16:
+            storeArrayInRange_<uint16_t>(values, count, static_cast<int64_t>(E57_UINT16_MIN), static_cast<int64_t>(E57_UINT16_MAX),
+                                         E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT32:
+            storeArrayInRange_<int32_t>(values, count, static_cast<int64_t>(E57_INT32_MIN), static_cast<int64_t>(E57_INT32_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT32:
+            storeArrayInRange_<uint32_t>(values, count, static_cast<int64_t>(E57_UINT32_MIN), static_cast<int64_t>(E57_UINT32_MAX),
+                                         E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT64:
+            storeArray_<int64_t>(values, count);
+            break;
+        case E57_REAL32:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            //??? very large integers may lose some lowest bits here. error?
+            storeArray_<float>(values, count);
+            break;
+        case E57_REAL64:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            storeArray_<double>(values, count);
+            break;
+        default:
+            /// E57_BOOL and E57_USTRING go through the per-value routine, which handles them.
+            for (size_t i = 0; i < count; i++)
+                setNextInt64(values[i]);
+    }
+}
+
+void SourceDestBufferImpl::setNextInt64Array(const int64_t* values, size_t count, double scale, double offset)
+{
+    /// don't checkImageFileOpen
+
+    /// If the user did not request scaling, then we send raw values to user's buffer.
+    if (!doScaling_) {
+        setNextInt64Array(values, count);
+        return;
+    }
+
+    checkArrayRoom_(count);
+
+    bool round = true;
+    switch (memoryRepresentation_) {
+        case E57_INT8: case E57_UINT8: case E57_INT16: case E57_UINT16:
+        case E57_INT32: case E57_UINT32: case E57_INT64:
+            break;
+        case E57_REAL32:
+        case E57_REAL64:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            /// Value will be stored in some floating point rep in user's buffer, so keep full resolution.
+            round = false;
+            break;
+        default:
+            for (size_t i = 0; i < count; i++)
+                setNextInt64(values[i], scale, offset);
+            return;
+    }
+
+    /// Calc x*scale+offset for a chunk, rounding to nearest integer for integer reps, then store the chunk.
+    double scaledValues[arrayChunkSize];
+    for (size_t done = 0; done < count; ) {
+        size_t n = count - done;
+        if (n > arrayChunkSize)
+            n = arrayChunkSize;
+
+        const int64_t* inp = &values[done];
+        if (round) {
+            for (size_t i = 0; i < n; i++)
+                scaledValues[i] = floor(inp[i]*scale + offset + 0.5);
+        } else {
+            for (size_t i = 0; i < n; i++)
+                scaledValues[i] = inp[i]*scale + offset;
+        }
+
+        switch (memoryRepresentation_) {
+            case E57_INT8:
+                storeArrayInRange_<int8_t>(scaledValues, n, static_cast<double>(E57_INT8_MIN), static_cast<double>(E57_INT8_MAX),
+                                           E57_ERROR_SCALED_VALUE_NOT_REPRESENTABLE, "scaledValue");
+                break;
+            case E57_UINT8:
+                storeArrayInRange_<uint8_t>(scaledValues, n, static_cast<double>(E57_UINT8_MIN), static_cast<double>(E57_UINT8_MAX),
+                                            E57_ERROR_SCALED_VALUE_NOT_REPRESENTABLE, "scaledValue");
+                break;
+            case E57_INT16:
+                storeArrayInRange_<int16_t>(scaledValues, n, static_cast<double>(E57_INT16_MIN), static_cast<double>(E57_INT16_MAX),
+                                            E57_ERROR_SCALED_VALUE_NOT_REPRESENTABLE, "scaledValue");
+                break;
+            case E57_UINT16:
+                storeArrayInRange_<uint16_t>(scaledValues, n, static_cast<double>(E57_UINT16_MIN), static_cast<double>(E57_UINT16_MAX),
+                                             E57_ERROR_SCALED_VALUE_NOT_REPRESENTABLE, "scaledValue");
+                break;
+            case E57_INT32:
+                storeArrayInRange_<int32_t>(scaledValues, n, static_cast<double>(E57_INT32_MIN), static_cast<double>(E57_INT32_MAX),
+                                            E57_ERROR_SCALED_VALUE_NOT_REPRESENTABLE, "scaledValue");
+                break;
+            case E57_UINT32:
+                storeArrayInRange_<uint32_t>(scaledValues, n, static_cast<double>(E57_UINT32_MIN), static_cast<double>(E57_UINT32_MAX),
+                                             E57_ERROR_SCALED_VALUE_NOT_REPRESENTABLE, "scaledValue");
+                break;
+            case E57_INT64:
+                storeArray_<int64_t>(scaledValues, n);
+                break;
+            case E57_REAL32:
+                /// Check that exponent of result is not too big for single precision float
+                storeArrayInRange_<float>(scaledValues, n, E57_DOUBLE_MIN, E57_DOUBLE_MAX,
+                                          E57_ERROR_SCALED_VALUE_NOT_REPRESENTABLE, "scaledValue");
+                break;
+            default:
+                storeArray_<double>(scaledValues, n);
+                break;
+        }
+        done += n;
+    }
+}
+
+template <typename T, SourceDestBufferImpl::Int64Conversion conversion>
+inline T SourceDestBufferImpl::convertInt64_(int64_t value, double scale, double offset)
+{
+    /// Same arithmetic as setNextInt64Array(), so the values stored are identical.
+    /// conversion is a compile time constant, so only one of these is left in each instantiation.
+    switch (conversion) {
+        case rawInt64:
+            return(static_cast<T>(value));
+        case scaledInt64:
+            return(static_cast<T>(value*scale + offset));
+        default:
+            return(static_cast<T>(floor(value*scale + offset + 0.5)));
+    }
+}
+
+template <typename T, SourceDestBufferImpl::Int64Conversion conversion>
+void SourceDestBufferImpl::storeInt64ArrayAs_(SourceDestBufferImpl* dbuf, const int64_t* values, size_t count, double scale, double offset)
+{
+    /// Caller has checked there is room, and int64ArrayStore() that every value converts into range.
+    char* p = &dbuf->base_[dbuf->nextIndex_*dbuf->stride_];
+
+    /// Contiguous buffers get a plain indexed loop the compiler can vectorize.
+    if (dbuf->stride_ == sizeof(T)) {
+        T* outp = reinterpret_cast<T*>(p);
+        for (size_t i = 0; i < count; i++)
+            outp[i] = convertInt64_<T, conversion>(values[i], scale, offset);
+    } else {
+        const size_t stride = dbuf->stride_;
+        for (size_t i = 0; i < count; i++, p += stride)
+            *reinterpret_cast<T*>(p) = convertInt64_<T, conversion>(values[i], scale, offset);
+    }
+    dbuf->nextIndex_ += static_cast<unsigned>(count);
+}
+
+SourceDestBufferImpl::Int64ArrayStore SourceDestBufferImpl::int64ArrayStore(int64_t minimum, int64_t maximum, bool isScaledInteger,
+                                                                            double scale, double offset)
+{
+    /// Dispatch table of the specialized stores, by representation and conversion.
+    /// Conversions are monotonic, so checking the ends of [minimum, maximum] checks every value in between.
+    /// Combinations that setNextInt64Array() could fault on, or sends through the per-value routines, get NULL.
+    if (isScaledInteger && doScaling_) {
+        double lo = minimum*scale + offset;
+        double hi = maximum*scale + offset;
+        if (hi < lo)
+            std::swap(lo, hi);
+        double roundedLo = floor(lo + 0.5);
+        double roundedHi = floor(hi + 0.5);
+        switch (memoryRepresentation_) {
+            case E57_INT8:
+                if (static_cast<double>(E57_INT8_MIN) <= roundedLo && roundedHi <= static_cast<double>(E57_INT8_MAX))
+                    return(&storeInt64ArrayAs_<int8_t, roundedScaledInt64>);
+                break;
+            case E57_UINT8:
+                if (static_cast<double>(E57_UINT8_MIN) <= roundedLo && roundedHi <= static_cast<double>(E57_UINT8_MAX))
+                    return(&storeInt64ArrayAs_<uint8_t, roundedScaledInt64>);
+                break;
+            case E57_INT16:
+                if (static_cast<double>(E57_INT16_MIN) <= roundedLo && roundedHi <= static_cast<double>(E57_INT16_MAX))
+                    return(&storeInt64ArrayAs_<int16_t, roundedScaledInt64>);
+                break;
+            case E57_UINT16:
+                if (static_cast<double>(E57_UINT16_MIN) <= roundedLo && roundedHi <= static_cast<double>(E57_UINT16_MAX))
+                    return(&storeInt64ArrayAs_<uint16_t, roundedScaledInt64>);
+                break;
+            case E57_INT32:
+                if (static_cast<double>(E57_INT32_MIN) <= roundedLo && roundedHi <= static_cast<double>(E57_INT32_MAX))
+                    return(&storeInt64ArrayAs_<int32_t, roundedScaledInt64>);
+                break;
+            case E57_UINT32:
+                if (static_cast<double>(E57_UINT32_MIN) <= roundedLo && roundedHi <= static_cast<double>(E57_UINT32_MAX))
+                    return(&storeInt64ArrayAs_<uint32_t, roundedScaledInt64>);
+                break;
+            case E57_INT64:
+                return(&storeInt64ArrayAs_<int64_t, roundedScaledInt64>);
+            case E57_REAL32:
+                if (doConversion_ && E57_DOUBLE_MIN <= lo && hi <= E57_DOUBLE_MAX)
+                    return(&storeInt64ArrayAs_<float, scaledInt64>);
+                break;
+            case E57_REAL64:
+                if (doConversion_)
+                    return(&storeInt64ArrayAs_<double, scaledInt64>);
+                break;
+            default:
+                break;
+        }
+        return(NULL);
+    }
+
+    /// Raw values, the same for Integer and ScaledInteger
+    switch (memoryRepresentation_) {
+        case E57_INT8:
+            if (static_cast<int64_t>(E57_INT8_MIN) <= minimum && maximum <= static_cast<int64_t>(E57_INT8_MAX))
+                return(&storeInt64ArrayAs_<int8_t, rawInt64>);
+            break;
+        case E57_UINT8:
+            if (static_cast<int64_t>(E57_UINT8_MIN) <= minimum && maximum <= static_cast<int64_t>(E57_UINT8_MAX))
+                return(&storeInt64ArrayAs_<uint8_t, rawInt64>);
+            break;
+        case E57_INT16:
+            if (static_cast<int64_t>(E57_INT16_MIN) <= minimum && maximum <= static_cast<int64_t>(E57_INT16_MAX))
+                return(&storeInt64ArrayAs_<int16_t, rawInt64>);
+            break;
+        case E57_UINT16:
+            if (static_cast<int64_t>(E57_UINT16_MIN) <= minimum && maximum <= static_cast<int64_t>(E57_UINT16_MAX))
+                return(&storeInt64ArrayAs_<uint16_t, rawInt64>);
+            break;
+        case E57_INT32:
+            if (static_cast<int64_t>(E57_INT32_MIN) <= minimum && maximum <= static_cast<int64_t>(E57_INT32_MAX))
+                return(&storeInt64ArrayAs_<int32_t, rawInt64>);
+            break;
+        case E57_UINT32:
+            if (static_cast<int64_t>(E57_UINT32_MIN) <= minimum && maximum <= static_cast<int64_t>(E57_UINT32_MAX))
+                return(&storeInt64ArrayAs_<uint32_t, rawInt64>);
+            break;
+        case E57_INT64:
+            return(&storeInt64ArrayAs_<int64_t, rawInt64>);
+        case E57_REAL32:
+            if (doConversion_)
+                return(&storeInt64ArrayAs_<float, rawInt64>);
+            break;
+        case E57_REAL64:
+            if (doConversion_)
+                return(&storeInt64ArrayAs_<double, rawInt64>);
+            break;
+        default:
+            break;
+    }
+    return(NULL);
+}
+
+void SourceDestBufferImpl::setNextFloatArray(const float* values, size_t count)
+{
+    /// don't checkImageFileOpen
+
+    checkArrayRoom_(count);
+
+    switch (memoryRepresentation_) {
+        case E57_INT8: case E57_UINT8: case E57_INT16: case E57_UINT16:
+        case E57_INT32: case E57_UINT32: case E57_INT64:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            break;
+        default:
+            break;
+    }
+
+    //??? fault if get special value: NaN, NegInf...  (all ints below)
+    switch (memoryRepresentation_) {
+        case E57_INT8:
+            storeArrayInRange_<int8_t>(values, count, static_cast<float>(E57_INT8_MIN), static_cast<float>(E57_INT8_MAX),
+                                       E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT8:
+            storeArrayInRange_<uint8_t>(values, count, static_cast<float>(E57_UINT8_MIN), static_cast<float>(E57_UINT8_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT16:
+            storeArrayInRange_<int16_t>(values, count, static_cast<float>(E57_INT16_MIN), static_cast<float>(E57_INT16_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT16:
+            storeArrayInRange_<uint16_t>(values, count, static_cast<float>(E57_UINT16_MIN), static_cast<float>(E57_UINT16_MAX),
+                                         E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT32:
+            storeArrayInRange_<int32_t>(values, count, static_cast<float>(E57_INT32_MIN), static_cast<float>(E57_INT32_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT32:
+            storeArrayInRange_<uint32_t>(values, count, static_cast<float>(E57_UINT32_MIN), static_cast<float>(E57_UINT32_MAX),
+                                         E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT64:
+            storeArrayInRange_<int64_t>(values, count, static_cast<float>(E57_INT64_MIN), static_cast<float>(E57_INT64_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_REAL32:
+            storeArray_<float>(values, count);
+            break;
+        case E57_REAL64:
+            storeArray_<double>(values, count);
+            break;
+        default:
+            for (size_t i = 0; i < count; i++)
+                setNextFloat(values[i]);
+    }
+}
+
+void SourceDestBufferImpl::setNextDoubleArray(const double* values, size_t count)
+{
+    /// don't checkImageFileOpen
+
+    checkArrayRoom_(count);
+
+    switch (memoryRepresentation_) {
+        case E57_INT8: case E57_UINT8: case E57_INT16: case E57_UINT16:
+        case E57_INT32: case E57_UINT32: case E57_INT64:
+            if (!doConversion_)
+                throw E57_EXCEPTION2(E57_ERROR_CONVERSION_REQUIRED, "pathName=" + pathName_);
+            break;
+        default:
+            break;
+    }
+
+    //??? fault if get special value: NaN, NegInf...  (all ints below)
+    switch (memoryRepresentation_) {
+        case E57_INT8:
+            storeArrayInRange_<int8_t>(values, count, static_cast<double>(E57_INT8_MIN), static_cast<double>(E57_INT8_MAX),
+                                       E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT8:
+            storeArrayInRange_<uint8_t>(values, count, static_cast<double>(E57_UINT8_MIN), static_cast<double>(E57_UINT8_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT16:
+            storeArrayInRange_<int16_t>(values, count, static_cast<double>(E57_INT16_MIN), static_cast<double>(E57_INT16_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT16:
+            storeArrayInRange_<uint16_t>(values, count, static_cast<double>(E57_UINT16_MIN), static_cast<double>(E57_UINT16_MAX),
+                                         E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT32:
+            storeArrayInRange_<int32_t>(values, count, static_cast<double>(E57_INT32_MIN), static_cast<double>(E57_INT32_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_UINT32:
+            storeArrayInRange_<uint32_t>(values, count, static_cast<double>(E57_UINT32_MIN), static_cast<double>(E57_UINT32_MAX),
+                                         E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_INT64:
+            storeArrayInRange_<int64_t>(values, count, static_cast<double>(E57_INT64_MIN), static_cast<double>(E57_INT64_MAX),
+                                        E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_REAL32:
+            /// Does this count as conversion?  It loses information.
+            /// Check for really large exponents that can't fit in a single precision
+            storeArrayInRange_<float>(values, count, E57_DOUBLE_MIN, E57_DOUBLE_MAX,
+                                      E57_ERROR_VALUE_NOT_REPRESENTABLE, "value");
+            break;
+        case E57_REAL64:
+            storeArray_<double>(values, count);
+            break;
+        default:
+            for (size_t i = 0; i < count; i++)
+                setNextDouble(values[i]);
+    }
+}
+
 void SourceDestBufferImpl::checkCompatible(shared_ptr<SourceDestBufferImpl> newBuf)
 {
     if (pathName_ != newBuf->pathName()) {
@@ -2079,7 +2734,9 @@ shared_ptr<CompressedVectorReaderImpl> CompressedVectorNodeImpl::reader(vector<S
                              + " writerCount=" + toString(destImageFile->writerCount())
                              + " readerCount=" + toString(destImageFile->readerCount()));
     }
-    if (destImageFile->readerCount() > 0) {
+    /// Readers of a read mode file each have their own packet cache and read the file without its cursor,
+    /// so any number can be open at once (see ImageFileImpl::readConcurrently).
+    if (destImageFile->isWriter() && destImageFile->readerCount() > 0) {
         throw E57_EXCEPTION2(E57_ERROR_TOO_MANY_READERS,
                              "fileName=" + destImageFile->fileName()
                              + " writerCount=" + toString(destImageFile->writerCount())
@@ -2723,6 +3380,15 @@ BlobNodeImpl::BlobNodeImpl(weak_ptr<ImageFileImpl> destImageFile, int64_t byteCo
     if (remainder > 0)
         binarySectionLogicalLength_ += 4 - remainder;
 
+    /// The section of an open CompressedVectorWriter runs up to the end of allocated space, a blob can't be put in it
+    if (imf->writerCount() > 0) {
+        throw E57_EXCEPTION2(E57_ERROR_TOO_MANY_WRITERS,
+                             "fileName=" + imf->fileName()
+                             + " writerCount=" + toString(imf->writerCount())
+                             + " readerCount=" + toString(imf->readerCount()));
+    }
+    std::lock_guard<std::mutex> fileLock(imf->binaryWriteMutex_);
+
     /// Reserve space for blob in file, extend with zeros since writes will happen at later time by caller
     binarySectionLogicalStart_ = imf->allocateSpace(binarySectionLogicalLength_, true);
 
@@ -2814,9 +3480,10 @@ void BlobNodeImpl::read(uint8_t* buf, int64_t start, size_t count)
                              + " count=" + toString(count)
                              + " length=" + toString(blobLogicalLength_));
     }
+    /// Positioned read, so blobs can be read from several threads at once
     shared_ptr<ImageFileImpl> imf(destImageFile_);
-    imf->file_->seek(binarySectionLogicalStart_ + sizeof(BlobSectionHeader) + start);
-    imf->file_->read(reinterpret_cast<char*>(buf), static_cast<size_t>(count));  //??? arg1 void* ?
+    imf->file_->readAt(binarySectionLogicalStart_ + sizeof(BlobSectionHeader) + start,
+                       reinterpret_cast<char*>(buf), static_cast<size_t>(count), true);  //??? arg1 void* ?
 }
 
 void BlobNodeImpl::write(uint8_t* buf, int64_t start, size_t count)
@@ -2840,6 +3507,7 @@ void BlobNodeImpl::write(uint8_t* buf, int64_t start, size_t count)
     }
 
     shared_ptr<ImageFileImpl> imf(destImageFile_);
+    std::lock_guard<std::mutex> fileLock(imf->binaryWriteMutex_);
     imf->file_->seek(binarySectionLogicalStart_ + sizeof(BlobSectionHeader) + start);
     imf->file_->write(reinterpret_cast<char*>(buf), static_cast<size_t>(count));  //??? arg1 void* ?
 }
@@ -2961,8 +3629,7 @@ XMLSize_t E57FileInputStream::readBytes(       XMLByte* const  toFill
 
     size_t readCount = min(maxToRead_size, available_size);
 
-    cf_->seek(logicalPosition_);
-    cf_->read(reinterpret_cast<char*>(toFill), readCount);  //??? cast ok?
+    cf_->readAt(logicalPosition_, reinterpret_cast<char*>(toFill), readCount);  //??? cast ok?
     logicalPosition_ += readCount;
     return(readCount);
 }
@@ -3742,7 +4409,121 @@ ImageFileImpl::ImageFileImpl()
     /// See ImageFileImpl::construct2() for second phase.
 }
 
-void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, const ustring& /*configuration*/)
+static bool configurationFlag(const ustring& setting, const ustring& value)
+{
+    if (value == "1" || value == "on" || value == "true")
+        return(true);
+    if (value == "0" || value == "off" || value == "false")
+        return(false);
+    throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "setting=" + setting + " value=" + value);
+}
+
+static unsigned configurationThreads(const ustring& setting, const ustring& value)
+{
+    if (value == "auto")
+        return(std::max(std::thread::hardware_concurrency(), 1U));
+    char* endp = NULL;
+    unsigned long threads = strtoul(value.c_str(), &endp, 10);
+    if (endp == value.c_str() || *endp != '\0' || threads < 1 || threads > 256)
+        throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "setting=" + setting + " value=" + value);
+    return(static_cast<unsigned>(threads));
+}
+
+void ImageFileImpl::parseConfiguration(const ustring& configuration, Options& options)
+{
+    /// The configuration string is a list of name=value settings, separated by spaces, ',' or ';'.
+    /// E.g. "mmap=on"
+    /// Recognized settings:
+    ///     mmap=on|off     Read through a memory mapping of the file instead of a pread per batch of pages (default off).
+    ///                     Ignored when writing, or if the file can't be mapped.
+    ///     checksum=all|headers|none|N%
+    ///                     Which page checksums are verified when reading (default all), see CheckedFile::ChecksumPolicy.
+    ///                     N% verifies headers plus N percent of the bulk data pages.
+    ///     threads=N|auto  Threads used by each CompressedVectorReader to decode its bytestreams (default 1, serial).
+    ///                     auto is one per hardware thread.
+    ///     encodeThreads=N|auto
+    ///                     Threads used by each CompressedVectorWriter to encode its bytestreams (default 1, serial).
+    ///                     The file written is the same, byte for byte.
+    ///     prefetch=N      Number of packets each CompressedVectorReader reads ahead on a background thread (default 0, off).
+    ///                     Only when reading a file.
+    ///     cache=N         Number of packets held by each CompressedVectorReader's packet cache.
+    ///                     Default is sized from the number of fields read, so that lagging fields don't cause packets to be re-read.
+    ///     index=N         Records per chunk of the index packets each CompressedVectorWriter writes (default 65536), 0 for no index.
+    ///                     Rounded up to a multiple of 64, see CompressedVectorWriterImpl::startChunk().
+    size_t start = 0;
+    while (start < configuration.length()) {
+        size_t end = configuration.find_first_of(" ,;", start);
+        if (end == ustring::npos)
+            end = configuration.length();
+        ustring setting = configuration.substr(start, end-start);
+        start = end + 1;
+        if (setting.empty())
+            continue;
+
+        size_t equals = setting.find('=');
+        if (equals == ustring::npos)
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "setting=" + setting);
+        ustring name  = setting.substr(0, equals);
+        ustring value = setting.substr(equals+1);
+
+        if (name == "mmap")
+            options.file.useMemoryMap = configurationFlag(name, value);
+        else if (name == "checksum") {
+            if (value == "all")
+                options.file.checksumPolicy = CheckedFile::checksumAll;
+            else if (value == "headers")
+                options.file.checksumPolicy = CheckedFile::checksumHeaders;
+            else if (value == "none")
+                options.file.checksumPolicy = CheckedFile::checksumNone;
+            else {
+                /// Must be a percentage 0-100, e.g. "10%"
+                char* endp = NULL;
+                unsigned long percent = strtoul(value.c_str(), &endp, 10);
+                if (endp == value.c_str() || ustring(endp) != "%" || percent > 100)
+                    throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "setting=" + setting);
+                options.file.checksumPolicy = CheckedFile::checksumSampled;
+                options.file.checksumSamplePercent = static_cast<unsigned>(percent);
+            }
+        } else if (name == "threads")
+            options.decodeThreads = configurationThreads(name, value);
+        else if (name == "encodeThreads")
+            options.encodeThreads = configurationThreads(name, value);
+        else if (name == "prefetch") {
+            char* endp = NULL;
+            unsigned long packets = strtoul(value.c_str(), &endp, 10);
+            if (endp == value.c_str() || *endp != '\0' || packets > 1024)
+                throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "setting=" + setting);
+            options.prefetchPackets = static_cast<unsigned>(packets);
+        } else if (name == "cache") {
+            char* endp = NULL;
+            unsigned long packets = strtoul(value.c_str(), &endp, 10);
+            if (endp == value.c_str() || *endp != '\0' || packets < 1 || packets > 4096)
+                throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "setting=" + setting);
+            options.cachePackets = static_cast<unsigned>(packets);
+        } else if (name == "index") {
+            char* endp = NULL;
+            unsigned long long records = strtoull(value.c_str(), &endp, 10);
+            if (endp == value.c_str() || *endp != '\0' || records > (1ULL << 40))
+                throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "setting=" + setting);
+            options.indexChunkRecords = (records + 63) & ~63ULL;
+        } else
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "setting=" + setting);
+    }
+}
+
+namespace {
+
+void initializeXmlPlatform()
+{
+    /// XMLPlatformUtils::Initialize() and Terminate() aren't thread safe, and a Terminate() would pull the platform out
+    /// from under parses running in other ImageFiles, so it is brought up once for the process and left up.
+    static std::once_flag initialized;
+    std::call_once(initialized, [](){ XMLPlatformUtils::Initialize(); });
+}
+
+} // namespace
+
+void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, const ustring& configuration)
 {
     /// Second phase of construction, now we have a well-formed ImageFile object.
 
@@ -3771,12 +4552,15 @@ void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, con
     else
         throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT, "mode=" + ustring(mode));
 
+    /// Decode any tuning options before touching the file
+    parseConfiguration(configuration, options_);
+
     /// If mode is read, do it
     file_ = NULL;
     if (!isWriter_) {
         try { //??? should one try block cover whole function?
             /// Open file for reading.
-            file_ = new CheckedFile(fileName_, CheckedFile::readOnly);
+            file_ = new CheckedFile(fileName_, CheckedFile::readOnly, options_.file);
 
 			shared_ptr<StructureNodeImpl> root(new StructureNodeImpl(imf));	//Added by SC
 			root_ = root;
@@ -3801,7 +4585,7 @@ void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, con
 
         // Initialize the XML4C2 system
         try {
-             XMLPlatformUtils::Initialize();
+             initializeXmlPlatform();
         } catch (const XMLException& ex) {
             /// Turn parser exception into E57Exception
              throw E57_EXCEPTION2(E57_ERROR_XML_PARSER_INIT, "parserMessage=" + ustring(XMLString::transcode(ex.getMessage())));
@@ -3844,12 +4628,10 @@ void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, con
         }
         delete xmlReader;
 
-		XMLPlatformUtils::Terminate();	//Added by SC
-
     } else { /// open for writing (start empty)
         try {
             /// Open file for writing, truncate if already exists.
-            file_ = new CheckedFile(fileName_, CheckedFile::writeCreate);
+            file_ = new CheckedFile(fileName_, CheckedFile::writeCreate, options_.file);
 
 			shared_ptr<StructureNodeImpl> root(new StructureNodeImpl(imf));	//Added by SC
 			root_ = root;
@@ -3879,7 +4661,7 @@ void ImageFileImpl::readFileHeader(CheckedFile* file, E57FileHeader& header)
 #endif
 
     /// Fetch the file header
-    file->read(reinterpret_cast<char*>(&header), sizeof(header));
+    file->readAt(0, reinterpret_cast<char*>(&header), sizeof(header));
 #ifdef E57_MAX_VERBOSE
     header.dump(); //???
 #endif
@@ -3941,11 +4723,13 @@ void ImageFileImpl::decrWriterCount()
 
 void ImageFileImpl::incrReaderCount()
 {
+    std::lock_guard<std::mutex> lock(readersMutex_);
     readerCount_++;
 }
 
 void ImageFileImpl::decrReaderCount()
 {
+    std::lock_guard<std::mutex> lock(readersMutex_);
     readerCount_--;
 #ifdef E57_MAX_DEBUG
     if (readerCount_ < 0) {
@@ -3972,6 +4756,8 @@ void ImageFileImpl::close()
     if (file_ == NULL)
         return;
 
+    freeSpareReadCaches();
+
     if (isWriter_) {
         /// Go to end of file, note physical position
         xmlLogicalOffset_ = unusedLogicalStart_;
@@ -4024,6 +4810,8 @@ void ImageFileImpl::cancel()
     if (file_ == NULL)
         return;
 
+    freeSpareReadCaches();
+
     /// Close the file and ulink (delete) it.
     /// It is legal to cancel a read file, but file isn't deleted.
     if (isWriter_)
@@ -4052,9 +4840,104 @@ int ImageFileImpl::writerCount()
 
 int ImageFileImpl::readerCount()
 {
+    std::lock_guard<std::mutex> lock(readersMutex_);
     return(readerCount_);
 }
 
+void ImageFileImpl::checksumStatistics(uint64_t& pagesRead, uint64_t& pagesChecked)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    pagesRead = file_->pagesReadCount();
+    pagesChecked = file_->pagesCheckedCount();
+}
+
+PacketReadCache* ImageFileImpl::acquireReadCache(unsigned packetCount)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    std::lock_guard<std::mutex> lock(readersMutex_);
+
+    /// Hand out a spare of the right size if have one, most recently released first
+    for (size_t i = spareReadCaches_.size(); i > 0; i--) {
+        PacketReadCache* cache = spareReadCaches_.at(i-1);
+        if (cache->packetCount() == packetCount) {
+            spareReadCaches_.erase(spareReadCaches_.begin() + (i-1));
+            return(cache);
+        }
+    }
+    return(new PacketReadCache(file_, packetCount));
+}
+
+void ImageFileImpl::releaseReadCache(PacketReadCache* cache)
+{
+    /// Keep a few spares (enough for readers of a handful of scans at once), free the rest.
+    /// Once file is closed, the cache can't be used again.
+    const size_t maxSpareReadCaches = 4;
+
+    if (cache == NULL)
+        return;
+    std::lock_guard<std::mutex> lock(readersMutex_);
+    if (file_ == NULL || spareReadCaches_.size() >= maxSpareReadCaches) {
+        delete cache;
+        return;
+    }
+
+    /// Forget packets and statistics of the reader that used it, so next reader starts fresh
+    cache->reset();
+    spareReadCaches_.push_back(cache);
+}
+
+void ImageFileImpl::freeSpareReadCaches()
+{
+    std::lock_guard<std::mutex> lock(readersMutex_);
+    for (size_t i = 0; i < spareReadCaches_.size(); i++)
+        delete spareReadCaches_.at(i);
+    spareReadCaches_.clear();
+}
+
+void ImageFileImpl::readConcurrently(const std::vector<ReadTask>& tasks, unsigned threadCount, uint64_t memoryLimit)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    if (isWriter_)
+        throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT, "fileName=" + fileName_);
+    if (tasks.empty())
+        return;
+
+    /// Zero means one thread per core, never need more threads than jobs
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1U);
+    if (threadCount > tasks.size())
+        threadCount = static_cast<unsigned>(tasks.size());
+
+    /// Each job is charged its own estimate plus the packet buffers of the reader it will open
+    MemoryBudget budget((memoryLimit == 0) ? E57_UINT64_MAX : memoryLimit);
+
+    /// Calling thread is one of the threadCount
+    WorkerPool pool(threadCount - 1);
+    pool.run(static_cast<unsigned>(tasks.size()), [this, &tasks, &budget](unsigned i) {
+        uint64_t bytes = tasks[i].memoryEstimate + readerMemoryEstimate(tasks[i].channelCount);
+        budget.acquire(bytes);
+        try {
+            tasks[i].run();
+        } catch (...) {
+            budget.release(bytes);
+            throw;
+        }
+        budget.release(bytes);
+    });
+}
+
+uint64_t ImageFileImpl::readerMemoryEstimate(unsigned channelCount)
+{
+    /// Packets a CompressedVectorReader of channelCount channels holds, sized as its constructor sizes them.
+    /// An unknown channelCount (0) is charged the 8 packet cache of a typical scan, and the parallel batch if configured.
+    unsigned cacheChannels = (channelCount > 0) ? channelCount : 6;
+    uint64_t packets = (options_.cachePackets > 0) ? options_.cachePackets : std::max(4U, cacheChannels + 2);
+    packets += options_.prefetchPackets;
+    if (options_.decodeThreads > 1 && (channelCount == 0 || channelCount > 1))
+        packets += CompressedVectorReaderImpl::batchPacketCount;
+    return(packets * E57_DATA_PACKET_MAX);
+}
+
 ImageFileImpl::~ImageFileImpl()
 {
     /// Try to cancel if not already closed, but don't allow any exceptions to propogate to caller (because in dtor).
@@ -4064,6 +4947,7 @@ ImageFileImpl::~ImageFileImpl()
     } catch (...) {};
 
     /// Just in case cancel failed without freeing file_, do free here.
+    freeSpareReadCaches();
     if (file_ != NULL) {
         delete file_;
         file_ = NULL;
@@ -4488,22 +5372,216 @@ void main()
 
 #endif
 
+//================================================================
+// CRC32C page checksums
+//
+// Castagnoli polynomial 0x1EDC6F41, reflected, initial remainder and final xor 0xFFFFFFFF.
+// Gives the same result as boost::crc_optimal<32,0x1EDC6F41,0xFFFFFFFF,0xFFFFFFFF,true,true>.
+// Uses the SSE4.2 crc32 instruction if the CPU has it (checked once at run-time),
+// otherwise a portable slicing-by-8 table method.
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#  define E57_CRC32C_SSE42 1
+#  include <nmmintrin.h>
+#endif
+
+namespace {
+
+const uint32_t crc32cReflectedPolynomial = 0x82F63B78;
+
+struct Crc32cTables {
+    uint32_t    t[8][256];
+
+                Crc32cTables() {
+                    for (uint32_t i = 0; i < 256; i++) {
+                        uint32_t crc = i;
+                        for (int bit = 0; bit < 8; bit++)
+                            crc = (crc >> 1) ^ ((crc & 1) ? crc32cReflectedPolynomial : 0);
+                        t[0][i] = crc;
+                    }
+                    for (uint32_t i = 0; i < 256; i++) {
+                        for (int k = 1; k < 8; k++)
+                            t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xFF];
+                    }
+                };
+};
+
+uint32_t crc32cSlicing8(uint32_t crc, const char* buf, size_t size)
+{
+    static const Crc32cTables tables;
+    const uint32_t (*t)[256] = tables.t;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(buf);
+
+#ifndef E57_BIGENDIAN
+    /// Fold in 8 bytes per step, one table lookup per byte
+    while (size >= 8) {
+        uint32_t low, high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p+4, 4);
+        low ^= crc;
+        crc = t[7][low & 0xFF]  ^ t[6][(low >> 8) & 0xFF]  ^ t[5][(low >> 16) & 0xFF]  ^ t[4][low >> 24]
+            ^ t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+        p += 8;
+        size -= 8;
+    }
+#endif
+    while (size > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        size--;
+    }
+    return(crc);
+}
+
+#ifdef E57_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+uint32_t crc32cSse42(uint32_t crc, const char* buf, size_t size)
+{
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t w;
+        memcpy(&w, buf, 8);
+        crc64 = _mm_crc32_u64(crc64, w);
+        buf += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while (size > 0) {
+        crc = _mm_crc32_u8(crc, static_cast<uint8_t>(*buf++));
+        size--;
+    }
+    return(crc);
+}
+
+/// Three independent blocks at once, so the crc32 instruction latency is hidden
+__attribute__((target("sse4.2")))
+void crc32cSse42x3(const char* a, const char* b, const char* c, size_t size, uint32_t* crcs)
+{
+    uint64_t crcA = 0xFFFFFFFF;
+    uint64_t crcB = 0xFFFFFFFF;
+    uint64_t crcC = 0xFFFFFFFF;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t wA, wB, wC;
+        memcpy(&wA, &a[i], 8);
+        memcpy(&wB, &b[i], 8);
+        memcpy(&wC, &c[i], 8);
+        crcA = _mm_crc32_u64(crcA, wA);
+        crcB = _mm_crc32_u64(crcB, wB);
+        crcC = _mm_crc32_u64(crcC, wC);
+    }
+    crcs[0] = ~crc32cSse42(static_cast<uint32_t>(crcA), &a[i], size - i);
+    crcs[1] = ~crc32cSse42(static_cast<uint32_t>(crcB), &b[i], size - i);
+    crcs[2] = ~crc32cSse42(static_cast<uint32_t>(crcC), &c[i], size - i);
+}
+#endif
+
+bool crc32cHardware()
+{
+#ifdef E57_CRC32C_SSE42
+    static const bool available = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2") != 0);
+    return(available);
+#else
+    return(false);
+#endif
+}
+
+uint32_t crc32c(const char* buf, size_t size)
+{
+#ifdef E57_CRC32C_SSE42
+    if (crc32cHardware())
+        return(~crc32cSse42(0xFFFFFFFF, buf, size));
+#endif
+    return(~crc32cSlicing8(0xFFFFFFFF, buf, size));
+}
+
+/// CRC32C of count blocks of size bytes each, stride bytes apart (e.g. the logical part of consecutive pages)
+void crc32cBlocks(const char* buf, size_t stride, size_t size, size_t count, uint32_t* crcs)
+{
+    size_t i = 0;
+#ifdef E57_CRC32C_SSE42
+    if (crc32cHardware()) {
+        for (; i + 3 <= count; i += 3)
+            crc32cSse42x3(&buf[i*stride], &buf[(i+1)*stride], &buf[(i+2)*stride], size, &crcs[i]);
+    }
+#endif
+    for (; i < count; i++)
+        crcs[i] = crc32c(&buf[i*stride], size);
+}
+
+}
+
+#ifdef CRC32C_UNIT_TEST
+
+#include <boost/crc.hpp>
+
+int main()
+{
+    /// Compare against the boost bytewise calculator that was used originally, all lengths up to a few pages and odd alignments
+    boost::crc_optimal<32, 0x1EDC6F41, 0xFFFFFFFF, 0xFFFFFFFF, true, true> reference;
+    vector<char> data(3*1024 + 16);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<char>(rand());
+
+    for (size_t start = 0; start < 8; start++) {
+        for (size_t size = 0; start + size <= data.size(); size++) {
+            reference.reset();
+            reference.process_bytes(&data[start], size);
+            uint32_t expected = reference.checksum();
+            if (crc32c(&data[start], size) != expected || ~crc32cSlicing8(0xFFFFFFFF, &data[start], size) != expected) {
+                std::cout << "OOPS: start=" << start << " size=" << size << endl;
+                exit(-1);
+            }
+        }
+    }
+
+    /// Batched pages must match one at a time
+    for (size_t count = 0; count <= 3; count++) {
+        uint32_t crcs[3];
+        crc32cBlocks(&data[0], 1024, 1020, count, crcs);
+        for (size_t i = 0; i < count; i++) {
+            if (crcs[i] != crc32c(&data[i*1024], 1020)) {
+                std::cout << "OOPS: count=" << count << " i=" << i << endl;
+                exit(-1);
+            }
+        }
+    }
+    std::cout << "crc32c OK, hardware=" << crc32cHardware() << endl;
+    return(0);
+}
+
+#endif
+
 //================================================================
 
 const size_t   CheckedFile::physicalPageSizeLog2 = 10;  // physical page size is 2 raised to this power
 const size_t   CheckedFile::physicalPageSize = 1 << physicalPageSizeLog2;
 const uint64_t CheckedFile::physicalPageSizeMask = physicalPageSize-1;
 const size_t   CheckedFile::logicalPageSize = physicalPageSize - 4;
+const size_t   CheckedFile::writeBufferPages = 1024;  // physical pages coalesced into one write call
 
-CheckedFile::CheckedFile(ustring fileName, Mode mode)
+CheckedFile::CheckedFile(ustring fileName, Mode mode, const Options& options)
 : fileName_(fileName),
-  fd_(-1)
+  fd_(-1),
+  readOnly_(false),
+  position_(0),
+  mapBase_(NULL),
+  mapLength_(0),
+  checksumPolicy_(options.checksumPolicy),
+  checksumSamplePercent_(options.checksumSamplePercent),
+  pagesRead_(0),
+  pagesChecked_(0),
+  readOnlyLength_(0),
+  writeBufferFirstPage_(0),
+  writeBufferPageCount_(0)
 {
     switch (mode) {
         case readOnly:
             fd_ = open64(fileName_, O_RDONLY|O_BINARY, 0);
+            readOnlyLength_ = length(physical);
             readOnly_ = true;
-            logicalLength_ = physicalToLogical(length(physical));
+            logicalLength_ = physicalToLogical(readOnlyLength_);
+            if (options.useMemoryMap)
+                mapFile();
             break;
         case writeCreate:
             /// File truncated to zero length if already exists
@@ -4559,42 +5637,78 @@ CheckedFile::~CheckedFile()
 }
 
 void CheckedFile::read(char* buf, size_t nRead, size_t /*bufSize*/)
+{
+    readPages(buf, nRead, false);
+}
+
+void CheckedFile::readBulkData(char* buf, size_t nRead)
+{
+    /// Same as read(), but the checksum policy may skip verifying these pages
+    readPages(buf, nRead, true);
+}
+
+void CheckedFile::readPages(char* buf, size_t nRead, bool isBulkData)
+{
+#ifdef SAFE_MODE
+    uint64_t start = position(logical);
+
+    readAt(start, buf, nRead, isBulkData);
+
+    /// When done, leave cursor just past end of last byte read
+    seek(start + nRead, logical);
+#endif  // SAFE_MODE
+}
+
+void CheckedFile::readAt(uint64_t logicalOffset, char* buf, size_t nRead, bool isBulkData)
 {
 //??? what if read past logical end?, or physical end?
 //??? need to keep track of logical length?
 //??? check bufSize OK
 
 #ifdef SAFE_MODE
-    uint64_t end = position(logical) + nRead;
+    uint64_t end = logicalOffset + nRead;
 
     if (end > length(logical))
         throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "fileName=" + fileName_ + " end=" + toString(end) + " length=" + toString(length(logical)));
 
-    uint64_t page;
-    size_t   pageOffset;
-    getCurrentPageAndOffset(page, pageOffset);
+    uint64_t page = logicalOffset / logicalPageSize;
+    size_t   pageOffset = static_cast<size_t>(logicalOffset - page * logicalPageSize);
 
     size_t n = min(nRead, logicalPageSize - pageOffset);
 
-    /// Allocate temp page buffer
-    vector<char> page_buffer_v(physicalPageSize);
-    char* page_buffer = &page_buffer_v[0];
+    /// Pages are fetched and checksummed in batches, rather than one at a time
+    const size_t maxBatchPages = 32;
+    size_t pagesLeft = (pageOffset + nRead + logicalPageSize - 1) / logicalPageSize;
+
+    /// Temp page buffer, a mapped file is copied from directly.
+    /// Several threads may be in here at once, so each has its own, allocated full size on first use, so later reads don't allocate.
+    static thread_local vector<char> page_buffer_v;
+    if (!isMapped() && page_buffer_v.empty())
+        page_buffer_v.resize(maxBatchPages * physicalPageSize);
 
     while (nRead > 0) {
-        readPhysicalPage(page_buffer, page);
-        memcpy(buf, page_buffer+pageOffset, n);
+        size_t batchPages = min(pagesLeft, maxBatchPages);
+        const char* batch;
+        if (isMapped())
+            batch = pageView(page, batchPages, isBulkData);
+        else {
+            readPhysicalPages(&page_buffer_v[0], page, batchPages, isBulkData);
+            batch = &page_buffer_v[0];
+        }
+        pagesRead_ += batchPages;
 
-        buf += n;
-        nRead -= n;
-        pageOffset = 0;
-        page++;
-        n = min(nRead, logicalPageSize);
+        for (size_t i = 0; i < batchPages; i++) {
+            memcpy(buf, &batch[i*physicalPageSize + pageOffset], n);
+
+            buf += n;
+            nRead -= n;
+            pageOffset = 0;
+            n = min(nRead, logicalPageSize);
+        }
+        page += batchPages;
+        pagesLeft -= batchPages;
     }
-
-    /// When done, leave cursor just past end of last byte read
-    seek(end, logical);
 #endif  // SAFE_MODE
-
 }
 
 void CheckedFile::write(const char* buf, size_t nWrite)
@@ -4614,24 +5728,22 @@ void CheckedFile::write(const char* buf, size_t nWrite)
 
     size_t n = min(nWrite, logicalPageSize - pageOffset);
 
-    /// Allocate temp page buffer
-    vector<char> page_buffer_v(physicalPageSize);
-    char* page_buffer = &page_buffer_v[0];
-
     while (nWrite > 0) {
-        readPhysicalPage(page_buffer, page);
+        char* page_buffer = bufferedPage(page);
+        if (page_buffer == NULL) {
 #ifdef E57_MAX_VERBOSE
-        // cout << "  page_buffer[0] read: '" << page_buffer[0] << "'" << endl;
-        // cout << "copy " << n << "bytes to page=" << page << " pageOffset=" << pageOffset << " buf='"; //???
-        for (size_t i=0; i < n; i++)
-            // cout << buf[i];
-        // cout << "'" << endl;
-#endif
-        memcpy(page_buffer+pageOffset, buf, n);
-        writePhysicalPage(page_buffer, page);
-#ifdef E57_MAX_VERBOSE
-        // cout << "  page_buffer[0] after write: '" << page_buffer[0] << "'" << endl; //???
-#endif
+            // cout << "  backpatch " << n << "bytes to page=" << page << " pageOffset=" << pageOffset << endl; //???
+#endif
+            /// Page is already in the file, so read-modify-write it in place
+            if (backpatchPage_.empty())
+                backpatchPage_.resize(physicalPageSize);
+            page_buffer = &backpatchPage_[0];
+            readPhysicalPage(page_buffer, page);
+            memcpy(page_buffer+pageOffset, buf, n);
+            writePhysicalPage(page_buffer, page);
+        } else
+            memcpy(page_buffer+pageOffset, buf, n);
+
         buf += n;
         nWrite -= n;
         pageOffset = 0;
@@ -4744,7 +5856,8 @@ void CheckedFile::seek(uint64_t offset, OffsetMode omode)
 #ifdef E57_MAX_VERBOSE
     // cout << "seek offset=" << offset << " omode=" << omode << " pos=" << pos << endl; //???
 #endif
-    lseek64(pos, SEEK_SET);
+    /// Nothing to tell the OS, every access gives its own offset
+    position_ = static_cast<uint64_t>(pos);
 #endif
 }
 
@@ -4780,13 +5893,10 @@ uint64_t CheckedFile::lseek64(int64_t offset, int whence)
 uint64_t CheckedFile::position(OffsetMode omode)
 {
 #ifdef SAFE_MODE
-    /// Get current file cursor position
-    uint64_t pos = lseek64(0LL, SEEK_CUR);
-
     if (omode==physical)
-        return(pos);
+        return(position_);
     else
-        return(physicalToLogical(pos));
+        return(physicalToLogical(position_));
 #endif  // SAFE_MODE
 }
 
@@ -4794,15 +5904,21 @@ uint64_t CheckedFile::length(OffsetMode omode)
 {
 #ifdef SAFE_MODE
     if (omode==physical) {
-        //??? is there a 64bit length call?
-        /// Get current file cursor position
-        uint64_t original_pos = lseek64(0LL, SEEK_CUR);
+        /// A readOnly file (which includes a mapped one) can't change length, and reading threads mustn't move the cursor
+        if (readOnly_)
+            return(readOnlyLength_);
 
-        /// Get current file cursor position
+        //??? is there a 64bit length call?
+        /// OS file offset isn't our cursor, so no need to put it back
+#if defined(WIN32)
+        std::lock_guard<std::mutex> lock(ioMutex_);
+#endif
         uint64_t end_pos = lseek64(0LL, SEEK_END);
 
-        /// Restore original position
-        lseek64(original_pos, SEEK_SET);
+        /// Pages still waiting in the write buffer may lie past the end of the file
+        uint64_t bufferEnd = (writeBufferFirstPage_ + writeBufferPageCount_) * physicalPageSize;
+        if (writeBufferPageCount_ > 0 && bufferEnd > end_pos)
+            end_pos = bufferEnd;
 
         return(end_pos);
     } else
@@ -4841,38 +5957,20 @@ void CheckedFile::extend(uint64_t newLength, OffsetMode omode)
     /// Seek to current end of file
     seek(currentLogicalLength, logical);
 
-    uint64_t page;
-    size_t   pageOffset;
-    getCurrentPageAndOffset(page, pageOffset);
-
-    /// Calc first write size (may be partial page)
+    /// Append the zeros a page at a time, so they go through the write buffer like any other append
     /// Watch out for different int sizes here.
-    size_t n;
-    if (nWrite < logicalPageSize - pageOffset)
-        n = static_cast<size_t>(nWrite);
-    else
-        n = logicalPageSize - pageOffset;
-
-    /// Allocate temp page buffer
-    vector<char> page_buffer_v(physicalPageSize);
-    char* page_buffer = &page_buffer_v[0];
-
+    vector<char> zeros(logicalPageSize, 0);
     while (nWrite > 0) {
-        readPhysicalPage(page_buffer, page);
-#ifdef E57_MAX_VERBOSE
-        // cout << "extend " << n << "bytes on page=" << page << " pageOffset=" << pageOffset << endl; //???
-#endif
-        memset(page_buffer+pageOffset, 0, n);
-        writePhysicalPage(page_buffer, page);
-
-        nWrite -= n;
-        pageOffset = 0;
-        page++;
-
+        size_t n;
         if (nWrite < logicalPageSize)
             n = static_cast<size_t>(nWrite);
         else
             n = logicalPageSize;
+#ifdef E57_MAX_VERBOSE
+        // cout << "extend " << n << "bytes at=" << position(logical) << endl; //???
+#endif
+        write(&zeros[0], n);
+        nWrite -= n;
     }
 
     //??? what if loop above throws, logicalLength_ may be wrong
@@ -4886,14 +5984,17 @@ void CheckedFile::extend(uint64_t newLength, OffsetMode omode)
 void CheckedFile::flush()
 {
 #ifdef SAFE_MODE
-    /// Nothing to do
+    flushWriteBuffer();
 #endif  // SAFE_MODE
 }
 
 void CheckedFile::close()
 {
+    unmapFile();
     if (fd_ >= 0) {
-#ifndef SAFE_MODE
+#ifdef SAFE_MODE
+        flushWriteBuffer();
+#else
         if (currentPageDirty_)
             finishPage();
 #endif  // SAFE_MODE
@@ -4912,6 +6013,11 @@ void CheckedFile::close()
 
 void CheckedFile::unlink()
 {
+    unmapFile();
+
+    /// File is going away, so don't bother writing out buffered pages
+    writeBufferPageCount_ = 0;
+
     if (fd_ >= 0) {
 #if defined(_MSC_VER)
         int result = ::_close(fd_);
@@ -4940,14 +6046,12 @@ size_t CheckedFile::efficientBufferSize(size_t logicalBytes)
 #endif  // SAFE_MODE
 }
 
-uint32_t CheckedFile::checksum(char* buf, size_t size)
+uint32_t CheckedFile::checksum(const char* buf, size_t size)
 {
 #ifdef SAFE_MODE
 #if 1
     /// Calc CRC32C of given data
-    crcCalculator_.reset();
-    crcCalculator_.process_bytes(buf, size);
-    uint32_t crc = crcCalculator_.checksum();
+    uint32_t crc = crc32c(buf, size);
     swab(crc); //!!! inside BIGENDIAN?
     return(crc);
 #else
@@ -4958,9 +6062,7 @@ uint32_t CheckedFile::checksum(char* buf, size_t size)
     int bytesPerBlock = size / blocksPerPage;
     uint32_t crc;
     for (int block = 0; block < blocksPerPage; block++) {
-        crcCalculator_.reset();
-        crcCalculator_.process_bytes(&buf[block*bytesPerBlock], bytesPerBlock);
-        crc = crcCalculator_.checksum();
+        crc = crc32c(&buf[block*bytesPerBlock], bytesPerBlock);
         swab(crc);
     }
     return(crc);
@@ -4983,38 +6085,79 @@ void CheckedFile::getCurrentPageAndOffset(uint64_t& page, size_t& pageOffset, Of
 }
 
 void CheckedFile::readPhysicalPage(char* page_buffer, uint64_t page)
+{
+    readPhysicalPages(page_buffer, page, 1);
+}
+
+void CheckedFile::readPhysicalPages(char* page_buffer, uint64_t page, size_t pageCount, bool isBulkData)
 {
 #ifdef E57_MAX_VERBOSE
-    // cout << "readPhysicalPage, page:" << page << endl;
+    // cout << "readPhysicalPages, page:" << page << " pageCount:" << pageCount << endl;
 #endif
 
-    if (page*physicalPageSize >= length(physical)) {
-        /// If beyond end of file, just return blank buffer  ???sure isn't partially beyond end?
-        memset(page_buffer, 0, physicalPageSize);
-    } else {
-        /// Seek to start of physical page
-        seek(page*physicalPageSize, physical);
+    /// Pages still in the write buffer have to reach the file before they can be read back
+    if (writeBufferPageCount_ > 0 && page < writeBufferFirstPage_ + writeBufferPageCount_
+                                  && writeBufferFirstPage_ < page + pageCount)
+        flushWriteBuffer();
 
-#if defined(_MSC_VER)
-        int result = ::_read(fd_, page_buffer, physicalPageSize);
-#elif defined(__GNUC__)
-        int result = ::read(fd_, page_buffer, physicalPageSize);
+    /// Count pages that are at least partly in the file
+    uint64_t fileLength = length(physical);
+    size_t existingCount = 0;
+    if (page*physicalPageSize < fileLength) {
+        uint64_t available = (fileLength - page*physicalPageSize + physicalPageSize - 1) >> physicalPageSizeLog2;
+        existingCount = static_cast<size_t>(min(available, static_cast<uint64_t>(pageCount)));
+    }
+
+    /// If beyond end of file, just return blank buffer  ???sure isn't partially beyond end?
+    if (existingCount < pageCount)
+        memset(&page_buffer[existingCount*physicalPageSize], 0, (pageCount - existingCount)*physicalPageSize);
+
+    if (existingCount > 0) {
+        /// Read all of the physical pages at once
+        readPhysical(page_buffer, existingCount*physicalPageSize, page*physicalPageSize);
+
+        checkPages(page_buffer, page, existingCount, isBulkData);
+    }
+}
+
+void CheckedFile::readPhysical(char* buf, size_t nRead, uint64_t physicalOffset)
+{
+    /// Positioned read, so concurrent readers don't disturb each other
+#if defined(WIN32)
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    lseek64(static_cast<int64_t>(physicalOffset), SEEK_SET);
+#  if defined(_MSC_VER)
+    int result = ::_read(fd_, buf, static_cast<unsigned>(nRead));
+#  else
+    ssize_t result = ::read(fd_, buf, nRead);
+#  endif
+#elif defined(LINUX)
+    ssize_t result = ::pread64(fd_, buf, nRead, static_cast<off64_t>(physicalOffset));
 #else
-#  error "no supported compiler defined"
+#  error "no supported OS platform defined"
 #endif
-        if (result < 0 || static_cast<size_t>(result) != physicalPageSize)
-            throw E57_EXCEPTION2(E57_ERROR_READ_FAILED, "fileName=" + fileName_ + " result=" + toString(result));
+    if (result < 0 || static_cast<size_t>(result) != nRead)
+        throw E57_EXCEPTION2(E57_ERROR_READ_FAILED, "fileName=" + fileName_ + " result=" + toString(result));
+}
 
-        uint32_t check_sum = checksum(page_buffer, logicalPageSize);
-        if(*reinterpret_cast<uint32_t*>(&page_buffer[logicalPageSize]) != check_sum) {  //??? little endian dependency
-            throw E57_EXCEPTION2(E57_ERROR_BAD_CHECKSUM,
-                                 "fileName=" + fileName_
-                                 + " computedChecksum=" + toString(check_sum)
-                                 + " storedChecksum=" + toString(*reinterpret_cast<uint32_t*>(&page_buffer[logicalPageSize]))
-                                 + " page=" + toString(page)
-                                 + " length=" + toString(length(physical)));
-        }
-    }
+void CheckedFile::writePhysical(const char* buf, size_t nWrite, uint64_t physicalOffset)
+{
+    /// Positioned write, same as readPhysical
+#if defined(WIN32)
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    lseek64(static_cast<int64_t>(physicalOffset), SEEK_SET);
+#  if defined(_MSC_VER)
+    int result = ::_write(fd_, buf, static_cast<unsigned>(nWrite));
+#  else
+    ssize_t result = ::write(fd_, buf, nWrite);
+#  endif
+#elif defined(LINUX)
+    ssize_t result = ::pwrite64(fd_, buf, nWrite, static_cast<off64_t>(physicalOffset));
+#else
+#  error "no supported OS platform defined"
+#endif
+    if (result < 0 || static_cast<size_t>(result) != nWrite)
+        throw E57_EXCEPTION2(E57_ERROR_WRITE_FAILED, "fileName=" + fileName_ + " result=" + toString(result));
 }
 
 void CheckedFile::writePhysicalPage(char* page_buffer, uint64_t page)
@@ -5027,22 +6170,193 @@ void CheckedFile::writePhysicalPage(char* page_buffer, uint64_t page)
     uint32_t check_sum = checksum(page_buffer, logicalPageSize);
     *reinterpret_cast<uint32_t*>(&page_buffer[logicalPageSize]) = check_sum;  //??? little endian dependency
 
-    /// Seek to start of physical page
-    seek(page*physicalPageSize, physical);
+    writePhysical(page_buffer, physicalPageSize, page*physicalPageSize);
+}
 
-#if defined(_MSC_VER)
-    int result = ::_write(fd_, page_buffer, physicalPageSize);
-#elif defined(__GNUC__)
-    int result = ::write(fd_, page_buffer, physicalPageSize);
-#else
-#  error "no supported compiler defined"
+char* CheckedFile::bufferedPage(uint64_t page)
+{
+    /// Return the write buffer copy of given page, adding the page to the buffer if it extends the current run.
+    /// Returns NULL for a page before the run, which is already in the file and must be read-modify-written there.
+    if (writeBufferPageCount_ > 0) {
+        if (page < writeBufferFirstPage_)
+            return(NULL);
+        if (page < writeBufferFirstPage_ + writeBufferPageCount_)
+            return(&writeBuffer_[static_cast<size_t>(page - writeBufferFirstPage_) * physicalPageSize]);
+
+        /// Start a new run if buffer is full, or page doesn't directly follow it
+        if (page != writeBufferFirstPage_ + writeBufferPageCount_ || writeBufferPageCount_ == writeBufferPages)
+            flushWriteBuffer();
+    }
+
+    if (writeBufferPageCount_ == 0) {
+        if (writeBuffer_.empty())
+            writeBuffer_.resize(writeBufferPages * physicalPageSize);
+        writeBufferFirstPage_ = page;
+    }
+
+    /// Only a page that already holds data needs fetching, pages past the logical end start out blank
+    char* page_buffer = &writeBuffer_[writeBufferPageCount_ * physicalPageSize];
+    if (page * logicalPageSize < logicalLength_)
+        readPhysicalPage(page_buffer, page);
+    else
+        memset(page_buffer, 0, physicalPageSize);
+    writeBufferPageCount_++;
+
+    return(page_buffer);
+}
+
+void CheckedFile::flushWriteBuffer()
+{
+    if (writeBufferPageCount_ == 0)
+        return;
+
+#ifdef E57_MAX_VERBOSE
+    // cout << "flushWriteBuffer, page:" << writeBufferFirstPage_ << " pageCount:" << writeBufferPageCount_ << endl;
 #endif
-    if (result < 0)
-        throw E57_EXCEPTION2(E57_ERROR_WRITE_FAILED, "fileName=" + fileName_ + " result=" + toString(result));
+
+    /// Append checksum to each page, now that its contents are final
+    for (size_t i = 0; i < writeBufferPageCount_; i++) {
+        char* page_buffer = &writeBuffer_[i * physicalPageSize];
+        uint32_t check_sum = checksum(page_buffer, logicalPageSize);
+        *reinterpret_cast<uint32_t*>(&page_buffer[logicalPageSize]) = check_sum;  //??? little endian dependency
+    }
+
+    /// Write whole run with one call
+    size_t nBytes = writeBufferPageCount_*physicalPageSize;
+    writeBufferPageCount_ = 0;
+    writePhysical(&writeBuffer_[0], nBytes, writeBufferFirstPage_*physicalPageSize);
 }
 
 #endif  // SAFE_MODE
 
+bool CheckedFile::checksumWanted(uint64_t page, bool isBulkData)
+{
+    switch (checksumPolicy_) {
+        case checksumAll:
+            return(true);
+        case checksumHeaders:
+            return(!isBulkData);
+        case checksumSampled: {
+            if (!isBulkData)
+                return(true);
+            /// Pseudo-random but repeatable choice of page, so a rerun checks the same pages
+            uint64_t h = (page + 1) * 0x9E3779B97F4A7C15ULL;
+            return(((h >> 32) % 100) < checksumSamplePercent_);
+        }
+        case checksumNone:
+            return(false);
+    }
+    return(true);
+}
+
+void CheckedFile::checkPages(const char* page_buffer, uint64_t page, size_t pageCount, bool isBulkData)
+{
+    /// Verify each run of pages that the checksum policy wants checked as one batch
+    size_t i = 0;
+    while (i < pageCount) {
+        if (!checksumWanted(page+i, isBulkData)) {
+            i++;
+            continue;
+        }
+        size_t runStart = i;
+        while (i < pageCount && checksumWanted(page+i, isBulkData))
+            i++;
+        verifyPages(&page_buffer[runStart*physicalPageSize], page+runStart, i-runStart);
+    }
+}
+
+void CheckedFile::verifyPages(const char* page_buffer, uint64_t page, size_t pageCount)
+{
+    pagesChecked_ += pageCount;
+
+    /// Checksum a group of pages per call, so the crc engine can work on several pages at once
+    const size_t groupSize = 12;
+    uint32_t check_sums[groupSize];
+
+    for (size_t i = 0; i < pageCount; i += groupSize) {
+        size_t n = min(groupSize, pageCount - i);
+        crc32cBlocks(&page_buffer[i*physicalPageSize], physicalPageSize, logicalPageSize, n, check_sums);
+
+        for (size_t j = 0; j < n; j++) {
+            uint32_t check_sum = check_sums[j];
+            swab(check_sum); //!!! inside BIGENDIAN?
+            const char* p = &page_buffer[(i+j)*physicalPageSize];
+            if(*reinterpret_cast<const uint32_t*>(&p[logicalPageSize]) != check_sum) {  //??? little endian dependency
+                throw E57_EXCEPTION2(E57_ERROR_BAD_CHECKSUM,
+                                     "fileName=" + fileName_
+                                     + " computedChecksum=" + toString(check_sum)
+                                     + " storedChecksum=" + toString(*reinterpret_cast<const uint32_t*>(&p[logicalPageSize]))
+                                     + " page=" + toString(page+i+j)
+                                     + " length=" + toString(length(physical)));
+            }
+        }
+    }
+}
+
+void CheckedFile::mapFile()
+{
+#if defined(LINUX)
+    uint64_t fileLength = length(physical);
+
+    /// Nothing to map in an empty file, and a 32 bit process may not have the address space.
+    /// In either case stay with the pread path.
+    if (fileLength == 0 || static_cast<uint64_t>(static_cast<size_t>(fileLength)) != fileLength)
+        return;
+
+    void* p = ::mmap(NULL, static_cast<size_t>(fileLength), PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED)
+        return;
+
+    mapBase_ = static_cast<char*>(p);
+    mapLength_ = fileLength;
+    std::vector<std::atomic<bool> > verified(static_cast<size_t>(fileLength >> physicalPageSizeLog2));
+    for (size_t i = 0; i < verified.size(); i++)
+        verified[i].store(false, std::memory_order_relaxed);
+    mapPageVerified_.swap(verified);
+#endif
+}
+
+void CheckedFile::unmapFile()
+{
+#if defined(LINUX)
+    if (mapBase_ != NULL) {
+        ::munmap(mapBase_, static_cast<size_t>(mapLength_));
+        mapBase_ = NULL;
+        mapLength_ = 0;
+        mapPageVerified_.clear();
+    }
+#endif
+}
+
+const char* CheckedFile::pageView(uint64_t page, size_t pageCount, bool isBulkData)
+{
+    if (!isMapped())
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "fileName=" + fileName_ + " page=" + toString(page));
+
+    /// Unlike readPhysicalPage, a page past the end is an error, there is no blank page to hand out
+    if ((page+pageCount)*physicalPageSize > mapLength_)
+        throw E57_EXCEPTION2(E57_ERROR_READ_FAILED, "fileName=" + fileName_ + " page=" + toString(page+pageCount-1) + " length=" + toString(mapLength_));
+
+    /// Checksum is verified only the first time a page is viewed (and only if policy wants it).
+    /// Each run of pages needing verification is checked as one batch.
+    /// Concurrent readers may both verify a page the first time, which is harmless.
+    size_t first = static_cast<size_t>(page);
+    size_t i = 0;
+    while (i < pageCount) {
+        if (mapPageVerified_[first+i] || !checksumWanted(page+i, isBulkData)) {
+            i++;
+            continue;
+        }
+        size_t runStart = i;
+        while (i < pageCount && !mapPageVerified_[first+i] && checksumWanted(page+i, isBulkData))
+            i++;
+        verifyPages(&mapBase_[(first+runStart)*physicalPageSize], page+runStart, i-runStart);
+        for (size_t j = runStart; j < i; j++)
+            mapPageVerified_[first+j] = true;
+    }
+    return(&mapBase_[page*physicalPageSize]);
+}
+
 //=============================================================
 #ifdef UNIT_TEST
 
@@ -5473,7 +6787,7 @@ void IndexPacket::verify(unsigned bufferLength, uint64_t totalRecordCount, uint6
     }
 
     /// Check if entries will fit in space provided
-    unsigned neededLength = 16 + 8*entryCount;
+    unsigned neededLength = 16 + sizeof(IndexPacketEntry)*entryCount;
     if (packetLength < neededLength) {
         throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
                              "packetLength=" + toString(packetLength)
@@ -5639,7 +6953,10 @@ struct SortByBytestreamNumber {
 CompressedVectorWriterImpl::CompressedVectorWriterImpl(shared_ptr<CompressedVectorNodeImpl> ni, vector<SourceDestBuffer>& sbufs)
 : isOpen_(false),  // set to true when succeed below
   cVector_(ni),
-  seekIndex_()      /// Init seek index for random access to beginning of chunks
+  pool_(NULL),
+  asyncRecordCount_(0),
+  asyncPending_(false),
+  writeThreadShutdown_(false)
 {
     //???  check if cvector already been written (can't write twice)
 
@@ -5675,7 +6992,9 @@ CompressedVectorWriterImpl::CompressedVectorWriterImpl(shared_ptr<CompressedVect
 
         /// EncoderFactory picks the appropriate encoder to match type declared in prototype
         bytestreams_.push_back(Encoder::EncoderFactory(static_cast<unsigned>(bytestreamNumber), cVector_, vTemp, codecPath));
+        sbufBytestreams_.push_back(static_cast<unsigned>(bytestreamNumber));
     }
+    sourceScratch_.reserve(1);
 
     /// The bytestreams_ vector must be ordered by bytestreamNumber, not by order called specified sbufs, so sort it.
     sort(bytestreams_.begin(), bytestreams_.end(), SortByBytestreamNumber());
@@ -5692,9 +7011,25 @@ CompressedVectorWriterImpl::CompressedVectorWriterImpl(shared_ptr<CompressedVect
 
     shared_ptr<ImageFileImpl> imf(ni->destImageFile_);
 
+    /// If configured for more than one thread, and more than one bytestream to share them, encode bytestreams in parallel.
+    /// A string can be longer than an Encoder's output buffer, which writeConcurrently() can't replay, so strings are always encoded serially.
+    stagedOutput_.resize(bytestreams_.size());
+    stagedFirst_.assign(bytestreams_.size(), 0);
+    bool hasStrings = false;
+    for (unsigned i=0; i < sbufs_.size(); i++) {
+        if (proto_->get(sbufs_.at(i).pathName())->type() == E57_STRING)
+            hasStrings = true;
+    }
+    unsigned threadCount = std::min(imf->options().encodeThreads, static_cast<unsigned>(bytestreams_.size()));
+    if (threadCount > 1 && !hasStrings)
+        pool_ = new WorkerPool(threadCount - 1);  /// caller of write() is the last thread
+
     /// Reserve space for CompressedVector binary section header, record location so can save to when writer closes.
     /// Request that file be extended with zeros since we will write to it at a later time (when writer closes).
-    sectionHeaderLogicalStart_ = imf->allocateSpace(sizeof(CompressedVectorSectionHeader), true);
+    {
+        std::lock_guard<std::mutex> fileLock(imf->binaryWriteMutex_);
+        sectionHeaderLogicalStart_ = imf->allocateSpace(sizeof(CompressedVectorSectionHeader), true);
+    }
 
     sectionLogicalLength_   = 0;
     dataPhysicalOffset_     = 0;
@@ -5703,6 +7038,21 @@ CompressedVectorWriterImpl::CompressedVectorWriterImpl(shared_ptr<CompressedVect
     dataPacketsCount_       = 0;
     indexPacketsCount_      = 0;
 
+    /// First chunk starts with first data packet
+    chunkRecordCount_       = imf->options().indexChunkRecords;
+    chunkStartRecordIndex_  = 0;
+    chunkEndRecordIndex_    = (chunkRecordCount_ > 0) ? chunkRecordCount_ : E57_UINT64_MAX;
+    chunkStartPending_      = (chunkRecordCount_ > 0);
+
+    /// Scratch used for every packet written, set up once here so writing records doesn't allocate.
+    /// Chunk tables only grow once per chunk, room for the first 256 chunks avoids even that for most scans.
+    packetAvailable_.resize(bytestreams_.size());
+    packetCount_.resize(bytestreams_.size());
+    if (chunkRecordCount_ > 0) {
+        chunkRecordNumbers_.reserve(256);
+        chunkPhysicalOffsets_.reserve(256);
+    }
+
     /// Just before return (and can't throw) increment writer count  ??? safer way to assure don't miss close?
     imf->incrWriterCount();
 
@@ -5722,6 +7072,8 @@ CompressedVectorWriterImpl::~CompressedVectorWriterImpl()
     } catch (...) {
         //??? report?
     }
+    stopWriteThread();
+    delete pool_;
 }
 
 void CompressedVectorWriterImpl::close()
@@ -5743,6 +7095,12 @@ void CompressedVectorWriterImpl::close()
     /// Set closed before do anything, so if get fault and start unwinding, don't try to close again.
     isOpen_ = false;
 
+    /// Let a write still running in the background finish (throwing if it failed), and stop its thread
+    waitForWrite();
+    stopWriteThread();
+
+    std::lock_guard<std::mutex> fileLock(imf->binaryWriteMutex_);
+
     /// If have any data, write packet
     /// Write all remaining ioBuffers and internal encoder register cache into file.
     /// Know we are done when totalOutputAvailable() returns 0 after a flush().
@@ -5752,6 +7110,9 @@ void CompressedVectorWriterImpl::close()
         flush();
     }
 
+    /// Index packets go after all the data packets
+    topIndexPhysicalOffset_ = writeIndexPackets();
+
     /// Compute length of whole section we just wrote (from section start to current start of free space).
     sectionLogicalLength_ = imf->unusedLogicalStart_ - sectionHeaderLogicalStart_;
 #ifdef E57_MAX_VERBOSE
@@ -5784,6 +7145,10 @@ void CompressedVectorWriterImpl::close()
 
     /// Free channels
     bytestreams_.clear();
+    stagedOutput_.clear();
+    stagedFirst_.clear();
+    delete pool_;
+    pool_ = NULL;
 
 #ifdef E57_MAX_VERBOSE
     cout << "  CompressedVectorWriter:" << endl;
@@ -5824,9 +7189,20 @@ void CompressedVectorWriterImpl::setBuffers(vector<SourceDestBuffer>& sbufs)
 
     /// Check sbufs well formed: no dups, no missing, no extra
     /// For writing, all data fields in prototype must be presented for writing at same time.
-    proto_->checkBuffers(sbufs, false);
+    /// New sbufs compatible with the old ones have the same paths in the same order, so are already known to be.
+    if (sbufs_.size() == 0)
+        proto_->checkBuffers(sbufs, false);
 
     sbufs_ = sbufs;
+
+    /// If encoders already exist (not called from ctor), they have to take from the new buffers from now on.
+    /// Encoders are ordered by bytestreamNumber, which ctor found from position of the path in the prototype.
+    /// Nothing here allocates, so a producer alternating between sets of buffers (see writeAsync) doesn't either.
+    for (size_t i = 0; i < sbufs_.size() && bytestreams_.size() > 0; i++) {
+        sourceScratch_.clear();
+        sourceScratch_.push_back(sbufs_.at(i));
+        bytestreams_.at(sbufBytestreams_.at(i))->sourceBufferSetNew(sourceScratch_);
+    }
 }
 
 void CompressedVectorWriterImpl::write(vector<SourceDestBuffer>& sbufs, const size_t requestedRecordCount)
@@ -5834,6 +7210,8 @@ void CompressedVectorWriterImpl::write(vector<SourceDestBuffer>& sbufs, const si
     /// don't checkImageFileOpen, write(unsigned) will do it
     /// don't checkWriterOpen(), write(unsigned) will do it
 
+    /// Encoders can't be given new buffers while a background write is using the old ones
+    waitForWrite();
     setBuffers(sbufs);
     write(requestedRecordCount);
 }
@@ -5846,6 +7224,92 @@ void CompressedVectorWriterImpl::write(const size_t requestedRecordCount)
     checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
     checkWriterOpen(__FILE__, __LINE__, __FUNCTION__);
 
+    waitForWrite();
+    writeRecords(requestedRecordCount);
+}
+
+void CompressedVectorWriterImpl::writeAsync(vector<SourceDestBuffer>& sbufs, const size_t requestedRecordCount)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    checkWriterOpen(__FILE__, __LINE__, __FUNCTION__);
+
+    /// Only one write at a time: wait for the previous one, whose buffers the caller can then reuse.
+    waitForWrite();
+    setBuffers(sbufs);
+
+    /// Check here, so a bad argument is reported by this call rather than a later one
+    if (requestedRecordCount > sbufs_.at(0).impl()->capacity()) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT,
+                             "requested=" + toString(requestedRecordCount)
+                             + " capacity=" + toString(sbufs_.at(0).impl()->capacity())
+                             + " imageFileName=" + cVector_->imageFileName()
+                             + " cvPathName=" + cVector_->pathName());
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    if (!writeThread_.joinable())
+        writeThread_ = std::thread(&CompressedVectorWriterImpl::writeThreadMain, this);
+    asyncRecordCount_ = requestedRecordCount;
+    asyncPending_ = true;
+    writeRequested_.notify_one();
+}
+
+void CompressedVectorWriterImpl::waitForWrite()
+{
+    /// Wait until no write is pending, then rethrow whatever the last one threw (just once)
+    std::unique_lock<std::mutex> lock(writeMutex_);
+    writeDone_.wait(lock, [this] {return(!asyncPending_);});
+    if (asyncError_) {
+        std::exception_ptr error = asyncError_;
+        asyncError_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+void CompressedVectorWriterImpl::writeThreadMain()
+{
+    std::unique_lock<std::mutex> lock(writeMutex_);
+    for (;;) {
+        writeRequested_.wait(lock, [this] {return(asyncPending_ || writeThreadShutdown_);});
+        if (!asyncPending_)
+            return;
+
+        /// Foreground only touches the writer again after waitForWrite(), so encode and write without the lock
+        size_t recordCount = asyncRecordCount_;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            writeRecords(recordCount);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        asyncError_ = error;
+        asyncPending_ = false;
+        writeDone_.notify_all();
+    }
+}
+
+void CompressedVectorWriterImpl::stopWriteThread()
+{
+    /// A pending write is finished first
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        writeThreadShutdown_ = true;
+        writeRequested_.notify_one();
+    }
+    if (writeThread_.joinable())
+        writeThread_.join();
+}
+
+void CompressedVectorWriterImpl::writeRecords(const size_t requestedRecordCount)
+{
+    /// Caller has checked ImageFile and writer are open, and no background write is pending.
+    /// Runs on writeThread_ for writeAsync(), so the file is only used under binaryWriteMutex_.
+    shared_ptr<ImageFileImpl> imf(cVector_->destImageFile_);
+    std::lock_guard<std::mutex> fileLock(imf->binaryWriteMutex_);
+
     /// Check that requestedRecordCount is not larger than the sbufs
     if (requestedRecordCount > sbufs_.at(0).impl()->capacity()) {
         throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT,
@@ -5859,8 +7323,28 @@ void CompressedVectorWriterImpl::write(const size_t requestedRecordCount)
     for (unsigned i=0; i < sbufs_.size(); i++)
         sbufs_.at(i).impl()->rewind();
 
-    /// Loop until all channels have completed requestedRecordCount transfers
+    /// Loop until all channels have completed requestedRecordCount transfers.
+    /// Records of each index chunk go in data packets of their own, so go up to the end of the current chunk at a time.
     uint64_t endRecordIndex = recordCount_ + requestedRecordCount;
+    for (uint64_t recordIndex = recordCount_; recordIndex < endRecordIndex; ) {
+        if (recordIndex == chunkEndRecordIndex_)
+            startChunk();
+        uint64_t segmentEndRecordIndex = std::min(endRecordIndex, chunkEndRecordIndex_);
+        if (pool_ != NULL)
+            writeConcurrently(segmentEndRecordIndex);
+        else
+            writeSerially(segmentEndRecordIndex);
+        recordIndex = segmentEndRecordIndex;
+    }
+
+    recordCount_ += requestedRecordCount;
+
+    /// When we leave this function, will likely still have data in channel ioBuffers as well as partial words in Encoder registers.
+}
+
+void CompressedVectorWriterImpl::writeSerially(uint64_t endRecordIndex)
+{
+    /// Encode all bytestreams up to endRecordIndex, writing data packets as they fill
     for (;;) {
         /// Calc remaining record counts for all channels
         uint64_t totalRecordCount = 0;
@@ -5911,35 +7395,214 @@ void CompressedVectorWriterImpl::write(const size_t requestedRecordCount)
 //!!!        unsigned appoxRecordsNeeded = static_cast<unsigned>(floor(spaceRemaining / totalBytesPerRecord)); //??? divide by zero if all constants
 
 
-        /// Don't allow straggler to get too far behind. ???
-        /// Don't allow a single channel to get too far ahead ???
-        /// Process channels that are furthest behind first. ???
+        /// Don't allow straggler to get too far behind. ???
+        /// Don't allow a single channel to get too far ahead ???
+        /// Process channels that are furthest behind first. ???
+
+        ///!!!! For now just process one record per loop until packet is full enough, or completed request
+        for (unsigned i=0; i < bytestreams_.size(); i++) {
+             if (bytestreams_.at(i)->currentRecordIndex() < endRecordIndex) {
+#if 0
+                bytestreams_.at(i)->processRecords(1);
+#else
+                //!!! For now, process up to 50 records at a time
+                uint64_t recordCount = endRecordIndex - bytestreams_.at(i)->currentRecordIndex();
+                recordCount = (recordCount<50ULL)?recordCount:50ULL; //min(recordCount, 50ULL);
+                bytestreams_.at(i)->processRecords((unsigned)recordCount);
+#endif
+            }
+        }
+    }
+}
+
+void CompressedVectorWriterImpl::startChunk()
+{
+    /// All bytestreams have reached chunkEndRecordIndex_, and there are records to write after it.
+    /// For CompressedVectorReaderImpl::seek(), a chunk's bytestreams must start at the beginning of the chunk's first data packet,
+    /// and on a word boundary of the Encoder.  Chunks are a multiple of 64 records, so every bytestream has ended the last chunk
+    /// on a whole number of words, and nothing is left in Encoder registers to pad.
+    /// So just write all output of the last chunk, and the next data packet will be the first of the new one.
+    while (totalOutputAvailable() > 0)
+        packetWrite();
+
+    chunkStartRecordIndex_ = chunkEndRecordIndex_;
+    chunkEndRecordIndex_  += chunkRecordCount_;
+    chunkStartPending_     = true;
+}
+
+uint64_t CompressedVectorWriterImpl::writeIndexPackets()
+{
+    /// Write the index packets of the chunks, and return physical offset of the top level one (0 if none).
+    /// Level 0 has an entry per chunk, pointing to its first data packet.
+    /// Each level above has an entry per packet of the level below, until one packet holds the whole level.
+    if (chunkRecordNumbers_.empty())
+        return(0);
+    shared_ptr<ImageFileImpl> imf(cVector_->destImageFile_);
+
+    vector<uint64_t> recordNumbers   = chunkRecordNumbers_;
+    vector<uint64_t> physicalOffsets = chunkPhysicalOffsets_;
+    std::unique_ptr<IndexPacket> packet(new IndexPacket);
+    for (unsigned level = 0; ; level++) {
+        /// Spread entries evenly over packets, so no packet above level 0 is left with a single entry
+        size_t entryTotal  = recordNumbers.size();
+        size_t packetCount = (entryTotal + IndexPacket::MAX_ENTRIES - 1) / IndexPacket::MAX_ENTRIES;
+        vector<uint64_t> upperRecordNumbers;
+        vector<uint64_t> upperPhysicalOffsets;
+        size_t first = 0;
+        for (size_t j = 0; j < packetCount; j++) {
+            size_t end = entryTotal * (j+1) / packetCount;
+
+            /// Index packets are written full size, unused entries zero, since IndexPacket::verify() requires it
+            *packet = IndexPacket();
+            packet->packetType                = E57_INDEX_PACKET;
+            packet->packetLogicalLengthMinus1 = static_cast<uint16_t>(sizeof(IndexPacket) - 1);
+            packet->entryCount                = static_cast<uint16_t>(end - first);
+            packet->indexLevel                = static_cast<uint8_t>(level);
+            for (size_t k = first; k < end; k++) {
+                packet->entries[k-first].chunkRecordNumber   = recordNumbers.at(k);
+                packet->entries[k-first].chunkPhysicalOffset = physicalOffsets.at(k);
+            }
+
+            /// Double check that index packet is well formed
+            packet->verify(sizeof(IndexPacket), recordCount_);
+#ifdef E57_BIGENDIAN
+            packet->swab(true);
+#endif
+
+            uint64_t packetLogicalOffset  = imf->allocateSpace(sizeof(IndexPacket), false);
+            uint64_t packetPhysicalOffset = imf->file_->logicalToPhysical(packetLogicalOffset);
+            imf->file_->seek(packetLogicalOffset);
+            imf->file_->write(reinterpret_cast<char*>(packet.get()), sizeof(IndexPacket));
+            indexPacketsCount_++;
+
+            upperRecordNumbers.push_back(recordNumbers.at(first));
+            upperPhysicalOffsets.push_back(packetPhysicalOffset);
+            first = end;
+        }
+        if (packetCount == 1)
+            return(upperPhysicalOffsets.at(0));
+        recordNumbers.swap(upperRecordNumbers);
+        physicalOffsets.swap(upperPhysicalOffsets);
+    }
+}
+
+void CompressedVectorWriterImpl::writeConcurrently(uint64_t endRecordIndex)
+{
+    /// Does what writeSerially() does, with the bytestreams encoded on pool_, and writes the same packets byte for byte.
+    /// The serial loop moves all bytestreams forward in lockstep, up to 50 records per step, and writes a packet as soon as
+    /// their output reaches E57_TARGET_PACKET_SIZE.  What goes in a packet depends only on how much output each bytestream has
+    /// at that point, and an Encoder's output bytes don't depend on when packets take them.
+    /// So first each bytestream encodes all of its steps on its own thread, into stagedOutput_, noting its output after every step.
+    /// Then the serial loop is replayed from those sizes, and packets are cut from stagedOutput_.
+    /// All scratch is kept in members, and only ever grows, so steady state writes don't allocate.
+    size_t bytestreamCount = bytestreams_.size();
+    uint64_t startRecordIndex = bytestreams_.at(0)->currentRecordIndex();
+    size_t stepCount = static_cast<size_t>((endRecordIndex - startRecordIndex + 49) / 50);
+
+    /// stepAvailable_[i*(stepCount+1) + s] is the output bytestream i would have after s steps of the serial loop, if no packet took any
+    if (stepAvailable_.size() < bytestreamCount * (stepCount+1))
+        stepAvailable_.resize(bytestreamCount * (stepCount+1));
+
+    /// Drop output already sent, and move what is still in the Encoders behind what is staged
+    for (unsigned i=0; i < bytestreamCount; i++) {
+        vector<char>& staged = stagedOutput_.at(i);
+        staged.erase(staged.begin(), staged.begin() + stagedFirst_.at(i));
+        stagedFirst_.at(i) = 0;
+        stageOutput(i);
+        stepAvailable_[i*(stepCount+1)] = staged.size();
+
+        /// Grow geometrically, so writes of slightly varying size settle on one buffer
+        size_t needed = staged.size() + static_cast<size_t>(bytestreams_.at(i)->bitsPerRecord() * (endRecordIndex - startRecordIndex) / 8) + 64;
+        if (needed > staged.capacity())
+            staged.reserve(std::max(needed, 2 * staged.capacity()));
+    }
+
+    /// Capture is kept to two words, small enough for std::function to hold without allocating
+    pool_->run(static_cast<unsigned>(bytestreamCount), [this, endRecordIndex](unsigned i) {
+        Encoder* encoder = bytestreams_.at(i).get();
+        size_t stepCount = static_cast<size_t>((endRecordIndex - encoder->currentRecordIndex() + 49) / 50);
+        for (size_t step = 0; step < stepCount; step++) {
+            uint64_t recordIndex = encoder->currentRecordIndex();
+            uint64_t recordCount = std::min(endRecordIndex - recordIndex, static_cast<uint64_t>(50));
+            encoder->processRecords(static_cast<size_t>(recordCount));
+
+            /// With its output staged as it grows, the Encoder never runs out of room, so it must have done the whole step
+            if (encoder->currentRecordIndex() != recordIndex + recordCount) {
+                throw E57_EXCEPTION2(E57_ERROR_INTERNAL,
+                                     "recordIndex=" + toString(recordIndex)
+                                     + " recordCount=" + toString(recordCount)
+                                     + " currentRecordIndex=" + toString(encoder->currentRecordIndex()));
+            }
+            stepAvailable_[i*(stepCount+1) + step+1] = stagedOutput_.at(i).size() + encoder->outputAvailable();
+            if (encoder->outputAvailable() > encoder->outputGetMaxSize() / 2)
+                stageOutput(i);
+        }
+        stageOutput(i);
+    });
+
+    /// Replay the serial loop.  Output taken by packets is subtracted from what each bytestream would have had.
+    stepTaken_.assign(bytestreamCount, 0);
+    size_t step = 0;
+    for (;;) {
+        size_t totalOutput = 0;
+        for (unsigned i=0; i < bytestreamCount; i++) {
+            packetAvailable_.at(i) = stepAvailable_[i*(stepCount+1) + step] - stepTaken_.at(i);
+            totalOutput += packetAvailable_.at(i);
+        }
+
+        /// Serial loop stops when all records are processed, whatever is left waits for the next write() or close()
+        if (step == stepCount)
+            break;
 
-        ///!!!! For now just process one record per loop until packet is full enough, or completed request
-        for (unsigned i=0; i < bytestreams_.size(); i++) {
-             if (bytestreams_.at(i)->currentRecordIndex() < endRecordIndex) {
-#if 0
-                bytestreams_.at(i)->processRecords(1);
-#else
-                //!!! For now, process up to 50 records at a time
-                uint64_t recordCount = endRecordIndex - bytestreams_.at(i)->currentRecordIndex();
-                recordCount = (recordCount<50ULL)?recordCount:50ULL; //min(recordCount, 50ULL);
-                bytestreams_.at(i)->processRecords((unsigned)recordCount);
-#endif
-            }
+        if (sizeof(DataPacketHeader) + bytestreamCount*sizeof(uint16_t) + totalOutput >= E57_TARGET_PACKET_SIZE) {
+            /// packetWrite() leaves how much it took from each bytestream in packetCount_
+            packetWrite(packetAvailable_);
+            for (unsigned i=0; i < bytestreamCount; i++)
+                stepTaken_.at(i) += packetCount_.at(i);
+            continue;
         }
+        step++;
     }
+}
 
-    recordCount_ += requestedRecordCount;
+void CompressedVectorWriterImpl::stageOutput(unsigned bytestreamNumber)
+{
+    /// Move all output of a bytestream's Encoder to the end of its stagedOutput_
+    Encoder* encoder = bytestreams_.at(bytestreamNumber).get();
+    size_t byteCount = encoder->outputAvailable();
+    if (byteCount == 0)
+        return;
+    vector<char>& staged = stagedOutput_.at(bytestreamNumber);
+    size_t oldSize = staged.size();
+    staged.resize(oldSize + byteCount);
+    encoder->outputRead(&staged[oldSize], byteCount);
+}
 
-    /// When we leave this function, will likely still have data in channel ioBuffers as well as partial words in Encoder registers.
+size_t CompressedVectorWriterImpl::bytestreamOutputAvailable(unsigned bytestreamNumber)
+{
+    return(stagedOutput_.at(bytestreamNumber).size() - stagedFirst_.at(bytestreamNumber)
+           + bytestreams_.at(bytestreamNumber)->outputAvailable());
+}
+
+void CompressedVectorWriterImpl::bytestreamOutputRead(unsigned bytestreamNumber, char* dest, size_t byteCount)
+{
+    /// Staged output is older than what is in the Encoder, so it goes first
+    vector<char>& staged = stagedOutput_.at(bytestreamNumber);
+    size_t& first = stagedFirst_.at(bytestreamNumber);
+    size_t fromStaged = std::min(byteCount, staged.size() - first);
+    if (fromStaged > 0) {
+        memcpy(dest, &staged[first], fromStaged);
+        first += fromStaged;
+    }
+    if (byteCount > fromStaged)
+        bytestreams_.at(bytestreamNumber)->outputRead(dest + fromStaged, byteCount - fromStaged);
 }
 
 size_t CompressedVectorWriterImpl::totalOutputAvailable()
 {
     size_t total = 0;
-    for (size_t i=0; i < bytestreams_.size(); i++) {
-        total += bytestreams_.at(i)->outputAvailable();
+    for (unsigned i=0; i < bytestreams_.size(); i++) {
+        total += bytestreamOutputAvailable(i);
     }
     return(total);
 }
@@ -5952,12 +7615,22 @@ size_t CompressedVectorWriterImpl::currentPacketSize()
 
 uint64_t CompressedVectorWriterImpl::packetWrite()
 {
+    for (unsigned i=0; i < bytestreams_.size(); i++)
+        packetAvailable_.at(i) = bytestreamOutputAvailable(i);
+    return(packetWrite(packetAvailable_));
+}
+
+uint64_t CompressedVectorWriterImpl::packetWrite(const vector<size_t>& available)
+{
+    /// Writes a packet from the first available[i] bytes of output of each bytestream i
 #ifdef E57_MAX_VERBOSE
     cout << "CompressedVectorWriterImpl::packetWrite() called" << endl; //???
 #endif
 
     /// Double check that we have work to do
-    size_t totalOutput = totalOutputAvailable();
+    size_t totalOutput = 0;
+    for (unsigned i=0; i < available.size(); i++)
+        totalOutput += available.at(i);
     if (totalOutput == 0)
         return(0);
 #ifdef E57_MAX_VERBOSE
@@ -5970,21 +7643,21 @@ uint64_t CompressedVectorWriterImpl::packetWrite()
     cout << "  packetMaxPayloadBytes=" << packetMaxPayloadBytes << endl; //???
 #endif
 
-    /// Allocate vector for number of bytes that each bytestream will write to file.
-    vector<size_t> count(bytestreams_.size());
+    /// Number of bytes that each bytestream will write to file, in scratch allocated by ctor.
+    vector<size_t>& count = packetCount_;
 
     /// See if we can fit into a single data packet
     if (totalOutput < packetMaxPayloadBytes) {
         /// We can fit everything in one packet
         for (unsigned i=0; i < bytestreams_.size(); i++)
-            count.at(i) = bytestreams_.at(i)->outputAvailable();
+            count.at(i) = available.at(i);
     } else {
         /// We have too much data for one packet.  Send proportional amounts from each bytestream.
         /// Adjust packetMaxPayloadBytes down by one so have a little slack for floating point weirdness.
         float fractionToSend =  (packetMaxPayloadBytes-1) / static_cast<float>(totalOutput);
         for (unsigned i=0; i < bytestreams_.size(); i++) {
             /// Round down here so sum <= packetMaxPayloadBytes
-            count.at(i) = static_cast<unsigned>(floor(fractionToSend * bytestreams_.at(i)->outputAvailable()));
+            count.at(i) = static_cast<unsigned>(floor(fractionToSend * available.at(i)));
         }
     }
 #ifdef E57_MAX_VERBOSE
@@ -6045,7 +7718,7 @@ uint64_t CompressedVectorWriterImpl::packetWrite()
 #endif
 
         /// Read from encoder output into packet
-        bytestreams_.at(i)->outputRead(p, n);
+        bytestreamOutputRead(static_cast<unsigned>(i), p, n);
 
         /// Move pointer to end of current data
         p += n;
@@ -6111,7 +7784,12 @@ uint64_t CompressedVectorWriterImpl::packetWrite()
         dataPhysicalOffset_ = packetPhysicalOffset;
     dataPacketsCount_++;
 
-    ///!!! update seekIndex here? if started new chunk?
+    /// If first data packet of a chunk, it goes in the index
+    if (chunkStartPending_) {
+        chunkRecordNumbers_.push_back(chunkStartRecordIndex_);
+        chunkPhysicalOffsets_.push_back(packetPhysicalOffset);
+        chunkStartPending_ = false;
+    }
 
     /// Return physical offset of data packet for potential use in seekIndex
     return(packetPhysicalOffset); //??? needed
@@ -6174,8 +7852,8 @@ void CompressedVectorWriterImpl::dump(int indent, std::ostream& os)
         bytestreams_.at(i)->dump(indent+4, os);
     }
 
-    os << space(indent) << "seekIndex:" << endl;
-    seekIndex_.dump(indent+4, os);
+    os << space(indent) << "chunkRecordCount:          " << chunkRecordCount_ << endl;
+    os << space(indent) << "chunks:                    " << chunkRecordNumbers_.size() << endl;
 
     /// Don't call dump() for DataPacket, since it may contain junk when debugging.  Just print a few byte values.
     os << space(indent) << "dataPacket:" << endl;
@@ -6194,13 +7872,224 @@ void CompressedVectorWriterImpl::dump(int indent, std::ostream& os)
     os << space(indent) << "indexPacketsCount:         " << indexPacketsCount_ << endl;
 }
 
+///================================================================
+
+SeekIndex::SeekIndex()
+: file_(NULL),
+  cache_(NULL),
+  indexLogicalOffset_(0),
+  dataLogicalOffset_(0),
+  sectionEndLogicalOffset_(0),
+  chunkRecordNumber_(0),
+  chunkLogicalOffset_(E57_UINT64_MAX),
+  scanLogicalOffset_(E57_UINT64_MAX),
+  bytestreamCount_(0)
+{
+}
+
+void SeekIndex::open(CheckedFile* file, PacketReadCache* cache, uint64_t indexLogicalOffset,
+                     uint64_t dataLogicalOffset, uint64_t sectionEndLogicalOffset)
+{
+    file_                    = file;
+    cache_                   = cache;
+    indexLogicalOffset_      = indexLogicalOffset;
+    dataLogicalOffset_       = dataLogicalOffset;
+    sectionEndLogicalOffset_ = sectionEndLogicalOffset;
+    chunkLogicalOffset_      = E57_UINT64_MAX;
+}
+
+uint64_t SeekIndex::startChunk(uint64_t recordNumber)
+{
+    /// Without index packets, the whole section is one chunk, and the table is kept from one seek to the next.
+    if (indexLogicalOffset_ == 0) {
+        if (chunkLogicalOffset_ == E57_UINT64_MAX)
+            resetTable(0, dataLogicalOffset_);
+        return(chunkRecordNumber_);
+    }
+
+    /// Walk down from the top level index packet, taking the last entry at or before recordNumber at each level.
+    uint64_t packetLogicalOffset = indexLogicalOffset_;
+    uint64_t foundRecordNumber   = 0;
+    unsigned expectedLevel       = E57_UINT32_MAX;  /// top level packet can be at any level
+    while (1) {
+        char* anyPacket = NULL;
+        PacketLock packetLock = cache_->lock(packetLogicalOffset, anyPacket);
+        IndexPacket* ipkt = reinterpret_cast<IndexPacket*>(anyPacket);
+
+        /// Quick check that packet looks ok.
+        /// Don't use IndexPacket::verify(), it insists on a full size packet, and index packets are usually shorter.
+        unsigned packetLength = ipkt->packetLogicalLengthMinus1 + 1;
+        if (ipkt->packetType != E57_INDEX_PACKET)
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetType=" + toString(ipkt->packetType));
+        if (ipkt->entryCount == 0 || ipkt->entryCount > IndexPacket::MAX_ENTRIES || 16 + 16*static_cast<unsigned>(ipkt->entryCount) > packetLength) {
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
+                                 "entryCount=" + toString(ipkt->entryCount)
+                                 + " packetLength=" + toString(packetLength));
+        }
+        if (expectedLevel != E57_UINT32_MAX && ipkt->indexLevel != expectedLevel) {
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
+                                 "indexLevel=" + toString(ipkt->indexLevel)
+                                 + " expectedLevel=" + toString(expectedLevel));
+        }
+
+        /// Binary search for last entry with record number <= recordNumber
+        unsigned low  = 0;
+        unsigned high = ipkt->entryCount - 1;
+        while (low < high) {
+            unsigned middle = (low + high + 1) >> 1;   /// middle > low, so will always make progress
+            if (ipkt->entries[middle].chunkRecordNumber <= recordNumber)
+                low = middle;
+            else
+                high = middle - 1;
+        }
+
+        /// First entry must cover recordNumber too
+        foundRecordNumber = ipkt->entries[low].chunkRecordNumber;
+        if (foundRecordNumber > recordNumber) {
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
+                                 "chunkRecordNumber=" + toString(foundRecordNumber)
+                                 + " recordNumber=" + toString(recordNumber));
+        }
+        packetLogicalOffset = file_->physicalToLogical(ipkt->entries[low].chunkPhysicalOffset);
+
+        /// Level 0 entries point at data packets, higher levels at index packets one level down.
+        if (ipkt->indexLevel == 0)
+            break;
+        expectedLevel = ipkt->indexLevel - 1;
+    }
+
+    /// Keep the table if still in same chunk
+    if (foundRecordNumber != chunkRecordNumber_ || packetLogicalOffset != chunkLogicalOffset_)
+        resetTable(foundRecordNumber, packetLogicalOffset);
+    return(chunkRecordNumber_);
+}
+
+bool SeekIndex::locate(unsigned bytestreamNumber, uint64_t byteOffset, uint64_t& packetLogicalOffset,
+                       size_t& bufferIndex, size_t& bufferLength)
+{
+    if (packetLogicalOffsets_.empty() && !scanPacket())
+        return(false);
+    if (bytestreamNumber >= bytestreamCount_) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
+                             "bytestreamNumber=" + toString(bytestreamNumber)
+                             + " bytestreamCount=" + toString(bytestreamCount_));
+    }
+
+    /// Scan further until some packet holds the byte, or run out of packets.
+    while (bytestreamEnds_[bytestreamNumber] <= byteOffset) {
+        if (!scanPacket())
+            return(false);
+    }
+
+    /// Binary search for the last packet whose buffer for the bytestream starts at or before byteOffset.
+    /// Since the bytestream doesn't end before byteOffset, that packet holds the byte.
+    size_t low  = 0;
+    size_t high = packetLogicalOffsets_.size() - 1;
+    while (low < high) {
+        size_t middle = (low + high + 1) >> 1;   /// middle > low, so will always make progress
+        if (bytestreamStarts_[middle*bytestreamCount_ + bytestreamNumber] <= byteOffset)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    uint64_t bufferStart = bytestreamStarts_[low*bytestreamCount_ + bytestreamNumber];
+    uint64_t bufferEnd;
+    if (low + 1 < packetLogicalOffsets_.size())
+        bufferEnd = bytestreamStarts_[(low+1)*bytestreamCount_ + bytestreamNumber];
+    else
+        bufferEnd = bytestreamEnds_[bytestreamNumber];
+
+    packetLogicalOffset = packetLogicalOffsets_[low];
+    bufferIndex         = static_cast<size_t>(byteOffset - bufferStart);
+    bufferLength        = static_cast<size_t>(bufferEnd - bufferStart);
+    return(true);
+}
+
+void SeekIndex::resetTable(uint64_t chunkRecordNumber, uint64_t chunkLogicalOffset)
+{
+    chunkRecordNumber_  = chunkRecordNumber;
+    chunkLogicalOffset_ = chunkLogicalOffset;
+    scanLogicalOffset_  = chunkLogicalOffset;
+    bytestreamCount_    = 0;
+    packetLogicalOffsets_.clear();
+    bytestreamStarts_.clear();
+    bytestreamEnds_.clear();
+}
+
+bool SeekIndex::scanPacket()
+{
+    /// Add the next data packet to the table.  Returns false if reached end of section first.
+    while (scanLogicalOffset_ < sectionEndLogicalOffset_) {
+        uint64_t packetLogicalOffset = scanLogicalOffset_;
+
+        /// Only need the header and the bytestream buffer lengths, not the whole packet.
+        /// All packets have type and length in the same place, so can use a data packet header to skip others.
+        DataPacketHeader header;
+        file_->readAt(packetLogicalOffset, reinterpret_cast<char*>(&header), sizeof(header));
+        header.swab();  /// swab if neccesary
+        scanLogicalOffset_ += header.packetLogicalLengthMinus1 + 1;
+
+        if (header.packetType == E57_INDEX_PACKET || header.packetType == E57_EMPTY_PACKET)
+            continue;
+        if (header.packetType != E57_DATA_PACKET) {
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
+                                 "packetType=" + toString(header.packetType)
+                                 + " packetLogicalOffset=" + toString(packetLogicalOffset));
+        }
+
+        /// Every data packet in a section has the same bytestreams
+        if (packetLogicalOffsets_.empty()) {
+            bytestreamCount_ = header.bytestreamCount;
+            bytestreamEnds_.assign(bytestreamCount_, 0);
+        } else if (header.bytestreamCount != bytestreamCount_) {
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
+                                 "bytestreamCount=" + toString(header.bytestreamCount)
+                                 + " expected=" + toString(bytestreamCount_)
+                                 + " packetLogicalOffset=" + toString(packetLogicalOffset));
+        }
+
+        /// Buffer lengths follow the header
+        bufferLengths_.resize(bytestreamCount_);
+        if (bytestreamCount_ > 0)
+            file_->readAt(packetLogicalOffset + sizeof(header), reinterpret_cast<char*>(&bufferLengths_[0]), 2*bytestreamCount_);
+
+        packetLogicalOffsets_.push_back(packetLogicalOffset);
+        bytestreamStarts_.insert(bytestreamStarts_.end(), bytestreamEnds_.begin(), bytestreamEnds_.end());
+        for (unsigned i = 0; i < bytestreamCount_; i++) {
+            SWAB(&bufferLengths_[i]);  /// swab if neccesary
+            bytestreamEnds_[i] += bufferLengths_[i];
+        }
+        return(true);
+    }
+
+    scanLogicalOffset_ = E57_UINT64_MAX;
+    return(false);
+}
+
+#ifdef E57_DEBUG
+void SeekIndex::dump(int indent, std::ostream& os)
+{
+    os << space(indent) << "indexLogicalOffset:      " << indexLogicalOffset_ << endl;
+    os << space(indent) << "dataLogicalOffset:       " << dataLogicalOffset_ << endl;
+    os << space(indent) << "sectionEndLogicalOffset: " << sectionEndLogicalOffset_ << endl;
+    os << space(indent) << "chunkRecordNumber:       " << chunkRecordNumber_ << endl;
+    os << space(indent) << "chunkLogicalOffset:      " << chunkLogicalOffset_ << endl;
+    os << space(indent) << "scanLogicalOffset:       " << scanLogicalOffset_ << endl;
+    os << space(indent) << "bytestreamCount:         " << bytestreamCount_ << endl;
+    os << space(indent) << "packets scanned:         " << packetLogicalOffsets_.size() << endl;
+}
+#endif
+
 ///================================================================
 ///================================================================
 ///================================================================
 
 CompressedVectorReaderImpl::CompressedVectorReaderImpl(shared_ptr<CompressedVectorNodeImpl> cvi, vector<SourceDestBuffer>& dbufs)
 : isOpen_(false),  // set to true when succeed below
-  cVector_(cvi)
+  cVector_(cvi),
+  pool_(NULL),
+  batchNextLogicalOffset_(E57_UINT64_MAX)
 {
 #ifdef E57_MAX_VERBOSE
     cout << "CompressedVectorReaderImpl() called" << endl; //???
@@ -6248,8 +8137,13 @@ CompressedVectorReaderImpl::CompressedVectorReaderImpl(shared_ptr<CompressedVect
 
     shared_ptr<ImageFileImpl> imf(cVector_->destImageFile_);
 
+    /// Each channel can be working on a different packet, plus room for the next packet when one runs out.
+    unsigned cachePackets = imf->options().cachePackets;
+    if (cachePackets == 0)
+        cachePackets = std::max(4U, static_cast<unsigned>(channels_.size()) + 2);
+
     //??? what if fault in this constructor?
-    cache_ = new PacketReadCache(imf->file_, 4/*???*/);
+    cache_ = imf->acquireReadCache(cachePackets);
 
     /// Read CompressedVector section header
     CompressedVectorSectionHeader sectionHeader;
@@ -6260,8 +8154,7 @@ CompressedVectorReaderImpl::CompressedVectorReaderImpl(shared_ptr<CompressedVect
                              "imageFileName=" + cVector_->imageFileName()
                              + " cvPathName=" + cVector_->pathName());
     }
-    imf->file_->seek(sectionLogicalStart, CheckedFile::logical);
-    imf->file_->read(reinterpret_cast<char*>(&sectionHeader), sizeof(sectionHeader));
+    imf->file_->readAt(sectionLogicalStart, reinterpret_cast<char*>(&sectionHeader), sizeof(sectionHeader));
     sectionHeader.swab();  /// swab if neccesary
 
 #ifdef E57_DEBUG
@@ -6274,10 +8167,16 @@ CompressedVectorReaderImpl::CompressedVectorReaderImpl(shared_ptr<CompressedVect
     /// Convert physical offset to first data packet to logical
     uint64_t dataLogicalOffset = imf->file_->physicalToLogical(sectionHeader.dataPhysicalOffset);
 
+    /// Index packets (if any) and data packet headers let seek() find records without decoding everything before them.
+    uint64_t indexLogicalOffset = 0;
+    if (sectionHeader.indexPhysicalOffset != 0)
+        indexLogicalOffset = imf->file_->physicalToLogical(sectionHeader.indexPhysicalOffset);
+    seekIndex_.open(imf->file_, cache_, indexLogicalOffset, dataLogicalOffset, sectionEndLogicalOffset_);
+
     /// Verify that packet given by dataPhysicalOffset is actually a data packet, init channels
     {
         char* anyPacket = NULL;
-        auto_ptr<PacketLock> packetLock = cache_->lock(dataLogicalOffset, anyPacket);
+        PacketLock packetLock = cache_->lock(dataLogicalOffset, anyPacket);
 
         DataPacket* dpkt = reinterpret_cast<DataPacket*>(anyPacket);
 
@@ -6292,6 +8191,23 @@ CompressedVectorReaderImpl::CompressedVectorReaderImpl(shared_ptr<CompressedVect
             chan->currentBytestreamBufferIndex  = 0;
             chan->currentBytestreamBufferLength = dpkt->getBytestreamBufferLength(chan->bytestreamNumber);
         }
+
+        /// If configured, start reading ahead from the packet after this one.
+        /// Not when writing, since the rest of the file may still be changing.
+        if (imf->options().prefetchPackets > 0 && !imf->isWriter()) {
+            cache_->startPrefetch(imf->fileName(), imf->options().file, imf->options().prefetchPackets,
+                                  dataLogicalOffset + dpkt->packetLogicalLengthMinus1 + 1, sectionEndLogicalOffset_);
+        }
+    }
+
+    /// If configured for more than one thread, and more than one channel to share them, decode channels in parallel.
+    /// No point having more threads than channels.
+    unsigned threadCount = std::min(imf->options().decodeThreads, static_cast<unsigned>(channels_.size()));
+    if (threadCount > 1) {
+        pool_ = new WorkerPool(threadCount - 1);  /// caller of read() is the last thread
+        batchBuffer_.resize(batchPacketCount * E57_DATA_PACKET_MAX);
+        batchLogicalOffsets_.reserve(batchPacketCount);
+        hungry_.reserve(channels_.size());
     }
 
     /// Just before return (and can't throw) increment reader count  ??? safer way to assure don't miss close?
@@ -6342,6 +8258,19 @@ void CompressedVectorReaderImpl::setBuffers(vector<SourceDestBuffer>& dbufs)
     }
 
     dbufs_ = dbufs;
+
+    /// If channels already exist (not called from ctor), their decoders have to fill the new buffers from now on
+    for (size_t i = 0; i < channels_.size(); i++) {
+        for (size_t j = 0; j < dbufs_.size(); j++) {
+            if (dbufs_[j].pathName() == channels_[i].dbuf.pathName()) {
+                vector<SourceDestBuffer> vTemp;
+                vTemp.push_back(dbufs_[j]);
+                channels_[i].dbuf = dbufs_[j];
+                channels_[i].decoder->destBufferSetNew(vTemp);
+                break;
+            }
+        }
+    }
 }
 
 unsigned CompressedVectorReaderImpl::read(vector<SourceDestBuffer>& dbufs)
@@ -6383,8 +8312,22 @@ unsigned CompressedVectorReaderImpl::read()
         if (earliestPacketLogicalOffset == E57_UINT64_MAX)
             break;
 
-        /// Feed packet to the hungry decoders
-        feedPacketToDecoders(earliestPacketLogicalOffset);
+        if (pool_ == NULL) {
+            /// Feed packet to the hungry decoders
+            feedPacketToDecoders(earliestPacketLogicalOffset);
+        } else {
+            /// Read a run of data packets once, then let each hungry channel eat as far as it can into it on its own thread.
+            /// Channels share nothing but the (read-only) batch, so they need no locking.
+            readBatch(earliestPacketLogicalOffset);
+            hungry_.clear();
+            for (unsigned i = 0; i < channels_.size(); i++) {
+                DecodeChannel* chan = &channels_[i];
+                if (!chan->isOutputBlocked() && !chan->inputFinished)
+                    hungry_.push_back(chan);
+            }
+            pool_->run(static_cast<unsigned>(hungry_.size()),
+                       [this](unsigned task) {feedBatchToDecoder(hungry_[task]);});
+        }
     }
 
     /// Verify that each channel produced the same number of records
@@ -6440,7 +8383,7 @@ void CompressedVectorReaderImpl::feedPacketToDecoders(uint64_t currentPacketLogi
     {
         /// Get packet at currentPacketLogicalOffset into memory.
         char* anyPacket = NULL;
-        auto_ptr<PacketLock> packetLock = cache_->lock(currentPacketLogicalOffset, anyPacket);
+        PacketLock packetLock = cache_->lock(currentPacketLogicalOffset, anyPacket);
         DataPacket* dpkt = reinterpret_cast<DataPacket*>(anyPacket);
 
         /// Double check that have a data packet.  Should have already determined this.
@@ -6507,7 +8450,7 @@ void CompressedVectorReaderImpl::feedPacketToDecoders(uint64_t currentPacketLogi
         if (nextPacketLogicalOffset < E57_UINT64_MAX) { //??? huh?
             /// Get packet at nextPacketLogicalOffset into memory.
             char* anyPacket = NULL;
-            auto_ptr<PacketLock> packetLock = cache_->lock(nextPacketLogicalOffset, anyPacket);
+            PacketLock packetLock = cache_->lock(nextPacketLogicalOffset, anyPacket);
             DataPacket* dpkt = reinterpret_cast<DataPacket*>(anyPacket);
 
             /// Got a data packet, update the channels with exhausted input
@@ -6556,7 +8499,7 @@ uint64_t CompressedVectorReaderImpl::findNextDataPacket(uint64_t nextPacketLogic
     /// Starting at nextPacketLogicalOffset, search for next data packet until hit end of binary section.
     while (nextPacketLogicalOffset < sectionEndLogicalOffset_) {
         char* anyPacket = NULL;
-        auto_ptr<PacketLock> packetLock = cache_->lock(nextPacketLogicalOffset, anyPacket);
+        PacketLock packetLock = cache_->lock(nextPacketLogicalOffset, anyPacket);
 
         /// Guess it's a data packet, if not continue to next packet
         DataPacket* dpkt = reinterpret_cast<DataPacket*>(anyPacket);
@@ -6575,12 +8518,134 @@ uint64_t CompressedVectorReaderImpl::findNextDataPacket(uint64_t nextPacketLogic
     return(E57_UINT64_MAX);
 }
 
-void CompressedVectorReaderImpl::seek(uint64_t /*recordNumber*/)
+void CompressedVectorReaderImpl::readBatch(uint64_t firstPacketLogicalOffset)
+{
+    /// Copy up to batchPacketCount consecutive data packets, starting at firstPacketLogicalOffset, into batchBuffer_.
+    /// Each packet occupies a E57_DATA_PACKET_MAX slot.
+    batchLogicalOffsets_.clear();
+    uint64_t packetLogicalOffset = firstPacketLogicalOffset;
+    while (packetLogicalOffset < E57_UINT64_MAX && batchLogicalOffsets_.size() < batchPacketCount) {
+        uint64_t nextPacketLogicalOffset;
+        {
+            char* anyPacket = NULL;
+            PacketLock packetLock = cache_->lock(packetLogicalOffset, anyPacket);
+            DataPacket* dpkt = reinterpret_cast<DataPacket*>(anyPacket);
+
+            /// Double check that have a data packet.  Should have already determined this.
+            if (dpkt->packetType != E57_DATA_PACKET)
+                throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "packetType=" + toString(dpkt->packetType));
+
+            size_t packetLength = dpkt->packetLogicalLengthMinus1 + 1;
+            memcpy(&batchBuffer_[batchLogicalOffsets_.size() * E57_DATA_PACKET_MAX], anyPacket, packetLength);
+            batchLogicalOffsets_.push_back(packetLogicalOffset);
+            nextPacketLogicalOffset = packetLogicalOffset + packetLength;
+        }
+
+        /// Skip over any index or empty packets to next data packet.
+        packetLogicalOffset = findNextDataPacket(nextPacketLogicalOffset);
+    }
+    batchNextLogicalOffset_ = packetLogicalOffset;
+}
+
+void CompressedVectorReaderImpl::feedBatchToDecoder(DecodeChannel* chan)
+{
+    /// Runs on a worker thread.  Only touches chan, its decoder and dbuf, and reads the batch.
+    /// Same bookkeeping as feedPacketToDecoders, except the channel moves on through the batch by itself.
+
+    /// Find the channel's current packet in the batch.  If it is past the end of this batch, it waits for a later one.
+    size_t batchIndex = 0;
+    while (batchIndex < batchLogicalOffsets_.size() && batchLogicalOffsets_[batchIndex] != chan->currentPacketLogicalOffset)
+        batchIndex++;
+
+    while (batchIndex < batchLogicalOffsets_.size() && !chan->isOutputBlocked()) {
+        DataPacket* dpkt = reinterpret_cast<DataPacket*>(&batchBuffer_[batchIndex * E57_DATA_PACKET_MAX]);
+
+        /// Get bytestream buffer for this channel from packet
+        unsigned bsbLength;
+        char* bsbStart = dpkt->getBytestream(chan->bytestreamNumber, bsbLength);
+        chan->currentBytestreamBufferLength = bsbLength;
+
+        /// Double check we are not off end of buffer
+        if (chan->currentBytestreamBufferIndex > bsbLength) {
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL,
+                                 "currentBytestreamBufferIndex =" + toString(chan->currentBytestreamBufferIndex)
+                                 + " bsbLength=" + toString(bsbLength));
+        }
+
+        /// Feed into decoder
+        size_t bytesProcessed = chan->decoder->inputProcess(&bsbStart[chan->currentBytestreamBufferIndex],
+                                                            bsbLength - chan->currentBytestreamBufferIndex);
+        chan->currentBytestreamBufferIndex += bytesProcessed;
+
+        /// If haven't exhausted this packet, decoder output must be full, so try again next read()
+        if (!chan->isInputBlocked())
+            continue;
+
+        /// Move to next data packet.  Its bytestream length gets filled in when it is fed.
+        batchIndex++;
+        chan->currentBytestreamBufferIndex = 0;
+        if (batchIndex < batchLogicalOffsets_.size())
+            chan->currentPacketLogicalOffset = batchLogicalOffsets_[batchIndex];
+        else if (batchNextLogicalOffset_ < E57_UINT64_MAX) {
+            chan->currentPacketLogicalOffset = batchNextLogicalOffset_;
+            chan->currentBytestreamBufferLength = 0;
+        } else {
+            /// Reached end without finding data packet, mark channel as finished
+            chan->currentBytestreamBufferLength = 0;
+            chan->inputFinished = true;
+        }
+    }
+}
+
+void CompressedVectorReaderImpl::seek(uint64_t recordNumber)
 {
     checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    checkReaderOpen(__FILE__, __LINE__, __FUNCTION__);
+
+    /// It's not an error to seek to one past the last record
+    if (recordNumber > maxRecordCount_) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT,
+                             "recordNumber=" + toString(recordNumber)
+                             + " maxRecordCount=" + toString(maxRecordCount_));
+    }
+
+    /// Find the chunk holding the record (the whole section, if it has no index packets).
+    /// Bytestream positions are counted from the start of the chunk.
+    uint64_t chunkRecordNumber = seekIndex_.startChunk(recordNumber);
+
+    /// Restart each decoder at the record, and point its channel at the packet and place in the bytestream buffer to feed from.
+    uint64_t earliestPacketLogicalOffset = E57_UINT64_MAX;
+    for (unsigned i = 0; i < channels_.size(); i++) {
+        DecodeChannel* chan = &channels_[i];
+        chan->inputFinished                 = false;
+        chan->currentPacketLogicalOffset    = E57_UINT64_MAX;
+        chan->currentBytestreamBufferIndex  = 0;
+        chan->currentBytestreamBufferLength = 0;
+
+        uint64_t byteOffset = chan->decoder->seekRecord(recordNumber, chunkRecordNumber);
+        if (byteOffset == E57_UINT64_MAX)
+            continue;  /// decoder needs no input, placed below
+
+        if (seekIndex_.locate(chan->bytestreamNumber, byteOffset, chan->currentPacketLogicalOffset,
+                              chan->currentBytestreamBufferIndex, chan->currentBytestreamBufferLength)) {
+            earliestPacketLogicalOffset = std::min(earliestPacketLogicalOffset, chan->currentPacketLogicalOffset);
+        } else {
+            /// Record is past end of bytestream (seek to end), nothing left to read
+            chan->inputFinished = true;
+        }
+    }
 
-    ///!!! implement
-    throw E57_EXCEPTION1(E57_ERROR_NOT_IMPLEMENTED);
+    /// Decoders that need no input just ride along with the others, starting at a packet that will be read anyway.
+    if (earliestPacketLogicalOffset == E57_UINT64_MAX)
+        earliestPacketLogicalOffset = seekIndex_.chunkLogicalOffset();
+    for (unsigned i = 0; i < channels_.size(); i++) {
+        DecodeChannel* chan = &channels_[i];
+        if (chan->currentPacketLogicalOffset == E57_UINT64_MAX && !chan->inputFinished)
+            chan->currentPacketLogicalOffset = earliestPacketLogicalOffset;
+    }
+
+    /// Anything read ahead is for the old position
+    cache_->restartPrefetch(earliestPacketLogicalOffset);
 }
 
 bool CompressedVectorReaderImpl::isOpen()
@@ -6609,12 +8674,24 @@ void CompressedVectorReaderImpl::close()
     /// Destroy decoders
     channels_.clear();
 
-    delete cache_;
+    /// Give cache back to the ImageFile, for the next reader to use
+    imf->releaseReadCache(cache_);
     cache_ = NULL;
 
+    delete pool_;
+    pool_ = NULL;
+
     isOpen_ = false;
 }
 
+void CompressedVectorReaderImpl::cacheStatistics(uint64_t& hits, uint64_t& misses, uint64_t& rereads)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    checkReaderOpen(__FILE__, __LINE__, __FUNCTION__);
+
+    cache_->statistics(hits, misses, rereads);
+}
+
 void CompressedVectorReaderImpl::checkImageFileOpen(const char* srcFileName, int srcLineNumber, const char* srcFunctionName)
 {
 #if 0
@@ -6988,25 +9065,29 @@ uint64_t BitpackFloatEncoder::processRecords(size_t recordCount)
         float* outp = reinterpret_cast<float*>(&outBuffer_[outBufferEnd_]);
 
         /// Copy floats from sourceBuffer_ to outBuffer_
+        sourceBuffer_->getNextFloatArray(outp, recordCount);
+#if defined(E57_BIGENDIAN) || defined(E57_MAX_VERBOSE)
         for (unsigned i=0; i < recordCount; i++) {
-            outp[i] = sourceBuffer_->getNextFloat();
 #ifdef E57_MAX_VERBOSE
             cout << "encoding float: " << outp[i] << endl;
 #endif
             SWAB(&outp[i]);  /// swab if neccesary
         }
+#endif
     } else {  /// E57_DOUBLE precision
         /// Form the starting address for next available location in outBuffer
         double* outp = reinterpret_cast<double*>(&outBuffer_[outBufferEnd_]);
 
         /// Copy doubles from sourceBuffer_ to outBuffer_
+        sourceBuffer_->getNextDoubleArray(outp, recordCount);
+#if defined(E57_BIGENDIAN) || defined(E57_MAX_VERBOSE)
         for (unsigned i=0; i < recordCount; i++) {
-            outp[i] = sourceBuffer_->getNextDouble();
 #ifdef E57_MAX_VERBOSE
             cout << "encoding double: " << outp[i] << endl;
 #endif
             SWAB(&outp[i]);  /// swab if neccesary
         }
+#endif
     }
 
     /// Update end of outBuffer
@@ -7305,7 +9386,7 @@ Decoder::Decoder(unsigned bytestreamNumber)
 BitpackDecoder::BitpackDecoder(unsigned bytestreamNumber, SourceDestBuffer& dbuf, unsigned alignmentSize, uint64_t maxRecordCount)
 : Decoder(bytestreamNumber),
   destBuffer_(dbuf.impl()),
-  inBuffer_(1024)            //!!! need to pick smarter channel buffer sizes
+  inBuffer_(1024 + inBufferGuardSize)    //!!! need to pick smarter channel buffer sizes
 {
     currentRecordIndex_     = 0;
     maxRecordCount_         = maxRecordCount;
@@ -7331,7 +9412,7 @@ size_t BitpackDecoder::inputProcess(const char* source, const size_t availableBy
     size_t bytesUnsaved = availableByteCount;
     size_t bitsEaten = 0;
     do {
-        size_t byteCount = min(bytesUnsaved, inBuffer_.size() - static_cast<size_t>(inBufferEndByte_));
+        size_t byteCount = min(bytesUnsaved, inBuffer_.size() - inBufferGuardSize - static_cast<size_t>(inBufferEndByte_));
 
         /// Copy input bytes from caller, if any
         if (byteCount > 0) {
@@ -7359,11 +9440,16 @@ size_t BitpackDecoder::inputProcess(const char* source, const size_t availableBy
         /// Now that we have input stored in an aligned buffer, call derived class to try to eat some
         /// Note that end of filled buffer may not be at a natural boundary.
         /// The subclass may transfer this partial word in a full word transfer, but it must be carefull to only use the defined bits.
-        /// inBuffer_ is a multiple of largest word size, so this full word transfer off the end will always be in defined memory.
+        /// inBuffer_ is a multiple of largest word size, plus a guard word that is never filled,
+        /// so this full word transfer off the end will always be in defined memory.
 
         size_t firstWord = inBufferFirstBit_ / bitsPerWord_;
         size_t firstNaturalBit = firstWord * bitsPerWord_;
         size_t endBit = inBufferEndByte_ * 8;
+
+        /// After a seek, the first bit can be past the (empty) end of buffer until the first input arrives
+        if (endBit < inBufferFirstBit_)
+            break;
 #ifdef E57_MAX_VERBOSE
     cout << "  feeding aligned decoder " << endBit - inBufferFirstBit_ << " bits." << endl;
 #endif
@@ -7397,6 +9483,23 @@ void BitpackDecoder::stateReset()
     inBufferEndByte_  = 0;
 }
 
+uint64_t BitpackDecoder::seekRecord(uint64_t recordIndex, uint64_t chunkRecordIndex)
+{
+    unsigned bitsPerRecord = recordBitCount();
+    if (bitsPerRecord == 0)
+        throw E57_EXCEPTION2(E57_ERROR_NOT_IMPLEMENTED, "bytestreamNumber=" + toString(bytestreamNumber_));
+
+    /// Start feeding at the word holding the first bit of the record, and skip the bits before it in that word.
+    /// Feeding from a word boundary keeps inBuffer_ on natural boundaries.
+    uint64_t streamBit  = (recordIndex - chunkRecordIndex) * bitsPerRecord;
+    uint64_t streamWord = streamBit / bitsPerWord_;
+
+    stateReset();
+    inBufferFirstBit_   = static_cast<size_t>(streamBit - streamWord*bitsPerWord_);
+    currentRecordIndex_ = recordIndex;
+    return(streamWord * bytesPerWord_);
+}
+
 void BitpackDecoder::inBufferShiftDown()
 {
     /// Move uneaten data down to beginning of inBuffer_.
@@ -7496,6 +9599,10 @@ size_t BitpackFloatDecoder::inputProcessAligned(const char* inbuf, const size_t
         /// Form the starting address for first data location in inBuffer
         const float* inp = reinterpret_cast<const float*>(inbuf);
 
+#if !defined(E57_BIGENDIAN) && !defined(E57_MAX_VERBOSE)
+        /// File order is memory order, so hand the whole run to the bulk routine.
+        destBuffer_->setNextFloatArray(inp, n);
+#else
         /// Copy floats from inbuf to destBuffer_
         for (unsigned i=0; i < n; i++) {
             float value = *inp;
@@ -7506,10 +9613,14 @@ size_t BitpackFloatDecoder::inputProcessAligned(const char* inbuf, const size_t
             destBuffer_->setNextFloat(value);
             inp++;
         }
+#endif
     } else {  /// E57_DOUBLE precision
         /// Form the starting address for first data location in inBuffer
         const double* inp = reinterpret_cast<const double*>(inbuf);
 
+#if !defined(E57_BIGENDIAN) && !defined(E57_MAX_VERBOSE)
+        destBuffer_->setNextDoubleArray(inp, n);
+#else
         /// Copy doubles from inbuf to destBuffer_
         for (unsigned i=0; i < n; i++) {
             double value = *inp;
@@ -7520,6 +9631,7 @@ size_t BitpackFloatDecoder::inputProcessAligned(const char* inbuf, const size_t
             destBuffer_->setNextDouble(value);
             inp++;
         }
+#endif
     }
 
     /// Update counts of records processed
@@ -7726,12 +9838,21 @@ size_t ConstantIntegerDecoder::inputProcess(const char* source, const size_t ava
     if (static_cast<uint64_t>(count) > remainingRecordCount)
         count = static_cast<unsigned>(remainingRecordCount);
 
-    if (isScaledInteger_) {
-        for (unsigned i = 0; i < count; i++)
-            destBuffer_->setNextInt64(minimum_, scale_, offset_);
-    } else {
-        for (unsigned i = 0; i < count; i++)
-            destBuffer_->setNextInt64(minimum_);
+    /// Store the constant a chunk at a time with the bulk routines
+    int64_t values[SourceDestBufferImpl::arrayChunkSize];
+    size_t chunkCount = count;
+    if (chunkCount > SourceDestBufferImpl::arrayChunkSize)
+        chunkCount = SourceDestBufferImpl::arrayChunkSize;
+    for (size_t i = 0; i < chunkCount; i++)
+        values[i] = minimum_;
+
+    for (size_t done = 0; done < count; done += chunkCount) {
+        if (chunkCount > count - done)
+            chunkCount = count - done;
+        if (isScaledInteger_)
+            destBuffer_->setNextInt64Array(values, chunkCount, scale_, offset_);
+        else
+            destBuffer_->setNextInt64Array(values, chunkCount);
     }
     currentRecordIndex_ += count;
     return(count);
@@ -7741,20 +9862,207 @@ void ConstantIntegerDecoder::stateReset()
 {
 }
 
+uint64_t ConstantIntegerDecoder::seekRecord(uint64_t recordIndex, uint64_t /*chunkRecordIndex*/)
+{
+    /// No bytestream data, so just carry on from recordIndex
+    currentRecordIndex_ = recordIndex;
+    return(E57_UINT64_MAX);
+}
+
 #ifdef E57_DEBUG
 void ConstantIntegerDecoder::dump(int indent, std::ostream& os)
 {
-    os << space(indent) << "bytestreamNumber:   " << bytestreamNumber_ << endl;
-    os << space(indent) << "currentRecordIndex: " << currentRecordIndex_ << endl;
-    os << space(indent) << "maxRecordCount:     " << maxRecordCount_ << endl;
-    os << space(indent) << "isScaledInteger:    " << isScaledInteger_ << endl;
-    os << space(indent) << "minimum:            " << minimum_ << endl;
-    os << space(indent) << "scale:              " << scale_ << endl;
-    os << space(indent) << "offset:             " << offset_ << endl;
-    os << space(indent) << "destBuffer:" << endl;
-    destBuffer_->dump(indent+4, os);
+    os << space(indent) << "bytestreamNumber:   " << bytestreamNumber_ << endl;
+    os << space(indent) << "currentRecordIndex: " << currentRecordIndex_ << endl;
+    os << space(indent) << "maxRecordCount:     " << maxRecordCount_ << endl;
+    os << space(indent) << "isScaledInteger:    " << isScaledInteger_ << endl;
+    os << space(indent) << "minimum:            " << minimum_ << endl;
+    os << space(indent) << "scale:              " << scale_ << endl;
+    os << space(indent) << "offset:             " << offset_ << endl;
+    os << space(indent) << "destBuffer:" << endl;
+    destBuffer_->dump(indent+4, os);
+}
+#endif
+
+//================================================================
+
+PacketPrefetcher::PacketPrefetcher(const ustring& fileName, const CheckedFile::Options& options, unsigned packetCount,
+                                   uint64_t firstPacketLogicalOffset, uint64_t sectionEndLogicalOffset)
+: file_(NULL),
+  sectionEndLogicalOffset_(sectionEndLogicalOffset),
+  nextLogicalOffset_(firstPacketLogicalOffset),
+  readingLogicalOffset_(E57_UINT64_MAX),
+  errorLogicalOffset_(E57_UINT64_MAX),
+  generation_(0),
+  shutdown_(false),
+  pagesRead_(0),
+  pagesChecked_(0),
+  pagesReadTaken_(0),
+  pagesCheckedTaken_(0)
+{
+    if (packetCount == 0)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "packetCount=" + toString(packetCount));
+
+    /// Open a second handle on the file, so the thread never disturbs the foreground file position.
+    file_ = new CheckedFile(fileName, CheckedFile::readOnly, options);
+    try {
+        free_.reserve(packetCount);
+        ready_.reserve(packetCount);
+        for (unsigned i = 0; i < packetCount; i++)
+            free_.push_back(new char[E57_DATA_PACKET_MAX]);
+        thread_ = std::thread(&PacketPrefetcher::threadMain, this);
+    } catch (...) {
+        for (unsigned i = 0; i < free_.size(); i++)
+            delete [] free_[i];
+        delete file_;
+        throw;  // rethrow
+    }
+}
+
+PacketPrefetcher::~PacketPrefetcher()
+{
+    stopThread();
+
+    /// Buffers may have been swapped with PacketReadCache buffers, but we still own the same number of them.
+    /// With the thread stopped, every one is either free or ready.
+    for (unsigned i = 0; i < free_.size(); i++)
+        delete [] free_[i];
+    for (unsigned i = 0; i < ready_.size(); i++)
+        delete [] ready_[i].buffer;
+    try {
+        file_->close();
+    } catch (...) {
+        //??? report?
+    }
+    delete file_;
+}
+
+void PacketPrefetcher::takePageCounts(uint64_t& pagesRead, uint64_t& pagesChecked)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    pagesRead          = pagesRead_ - pagesReadTaken_;
+    pagesChecked       = pagesChecked_ - pagesCheckedTaken_;
+    pagesReadTaken_    = pagesRead_;
+    pagesCheckedTaken_ = pagesChecked_;
+}
+
+void PacketPrefetcher::restart(uint64_t packetLogicalOffset)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!ready_.empty())
+        recycleFront();
+    nextLogicalOffset_  = packetLogicalOffset;
+    errorLogicalOffset_ = E57_UINT64_MAX;
+    generation_++;   /// so any read in progress is discarded
+    wakeThread_.notify_one();
+}
+
+void PacketPrefetcher::stopThread()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    wakeThread_.notify_all();
+    packetReady_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void PacketPrefetcher::recycleFront()
+{
+    /// Called with mutex_ held.  Give oldest ready packet buffer back to the thread.
+    free_.push_back(ready_.front().buffer);
+    ready_.erase(ready_.begin());
+    wakeThread_.notify_one();
+}
+
+bool PacketPrefetcher::take(uint64_t packetLogicalOffset, char* &buffer)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (1) {
+        /// Packets earlier than requested won't be asked for again (or if they are, the caller can read them itself).
+        while (!ready_.empty() && ready_.front().logicalOffset < packetLogicalOffset)
+            recycleFront();
+
+        /// If have it, swap buffers with caller.  Caller's old buffer can be used for next read ahead.
+        if (!ready_.empty() && ready_.front().logicalOffset == packetLogicalOffset) {
+            std::swap(buffer, ready_.front().buffer);
+            recycleFront();
+            return(true);
+        }
+
+        /// If read ahead failed on this packet, let caller read it, so it gets the full error.
+        if (errorLogicalOffset_ == packetLogicalOffset)
+            return(false);
+
+        /// If packet is being read, or is next to be read, wait for it.
+        if (readingLogicalOffset_ == packetLogicalOffset ||
+            (ready_.empty() && nextLogicalOffset_ == packetLogicalOffset && packetLogicalOffset < sectionEndLogicalOffset_)) {
+            wakeThread_.notify_one();
+            packetReady_.wait(lock);
+            continue;
+        }
+
+        /// If caller has jumped past everything read ahead so far, start read ahead over from the requested packet.
+        /// Any read in progress gets discarded.
+        if (ready_.empty() && nextLogicalOffset_ < packetLogicalOffset && packetLogicalOffset < sectionEndLogicalOffset_) {
+            nextLogicalOffset_ = packetLogicalOffset;
+            errorLogicalOffset_ = E57_UINT64_MAX;
+            generation_++;
+            continue;
+        }
+
+        /// Must be a packet behind the read ahead, caller reads it.
+        return(false);
+    }
+}
+
+void PacketPrefetcher::threadMain()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (1) {
+        wakeThread_.wait(lock, [this] {return(shutdown_ ||
+                                              (!free_.empty() && nextLogicalOffset_ < sectionEndLogicalOffset_
+                                               && errorLogicalOffset_ == E57_UINT64_MAX));});
+        if (shutdown_)
+            return;
+
+        char* buffer = free_.back();
+        free_.pop_back();
+        uint64_t packetLogicalOffset = nextLogicalOffset_;
+        unsigned generation = generation_;
+        readingLogicalOffset_ = packetLogicalOffset;
+
+        /// Read and check packet without holding mutex
+        unsigned packetLength = 0;
+        bool failed = false;
+        lock.unlock();
+        try {
+            packetLength = PacketReadCache::readPacketFrom(file_, packetLogicalOffset, buffer);
+        } catch (...) {
+            failed = true;
+        }
+        lock.lock();
+        readingLogicalOffset_ = E57_UINT64_MAX;
+        pagesRead_    = file_->pagesReadCount();
+        pagesChecked_ = file_->pagesCheckedCount();
+
+        if (generation != generation_ || failed) {
+            /// Restarted elsewhere while reading, or read failed.  Don't go past a bad packet.
+            free_.push_back(buffer);
+            if (generation == generation_)
+                errorLogicalOffset_ = packetLogicalOffset;
+        } else {
+            Slot slot;
+            slot.logicalOffset = packetLogicalOffset;
+            slot.buffer        = buffer;
+            ready_.push_back(slot);
+            nextLogicalOffset_ = packetLogicalOffset + packetLength;
+        }
+        packetReady_.notify_all();
+    }
 }
-#endif
 
 //================================================================
 
@@ -7767,11 +10075,21 @@ PacketLock::PacketLock(PacketReadCache* cache, unsigned cacheIndex)
 #endif
 }
 
+PacketLock::PacketLock(PacketLock&& plock)
+: cache_(plock.cache_),
+  cacheIndex_(plock.cacheIndex_)
+{
+    /// Lock now belongs to this object, so plock's destructor must not unlock
+    plock.cache_ = NULL;
+}
+
 PacketLock::~PacketLock()
 {
 #ifdef E57_MAX_VERBOSE
     cout << "~PacketLock() called" << endl;
 #endif
+    if (cache_ == NULL)
+        return;
     try {
         /// Note cache must live longer than lock, this is reasonable assumption.
         cache_->unlock(cacheIndex_);
@@ -7782,23 +10100,43 @@ PacketLock::~PacketLock()
 
 PacketReadCache::PacketReadCache(CheckedFile* cFile, unsigned packetCount)
 : lockCount_(0),
-  useCount_(0),
+  newestEntry_(noEntry),
+  oldestEntry_(noEntry),
   cFile_(cFile),
-  entries_(packetCount)
-{
-    if (packetCount == 0)
+  entries_(packetCount),
+  hits_(0),
+  misses_(0),
+  rereads_(0),
+  prefetcher_(NULL)
+{
+    /// entrySlots_ has twice as many slots as entries, which must fit an unsigned
+    if (packetCount == 0 || packetCount > (1U << 30))
         throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "packetCount=" + toString(packetCount));
 
     /// Allocate requested number of maximum sized data packets buffers for holding data read from file
+    /// Start with entries linked in index order, entry 0 the oldest.
     for (unsigned i=0; i < entries_.size(); i++) {
         entries_.at(i).logicalOffset_ = 0;
         entries_.at(i).buffer_        = new char[E57_DATA_PACKET_MAX];
-        entries_.at(i).lastUsed_      = 0;
+        entries_.at(i).lockCount_     = 0;
+        entries_.at(i).older_         = (i == 0) ? noEntry : i-1;
+        entries_.at(i).newer_         = (i+1 == entries_.size()) ? noEntry : i+1;
     }
+    oldestEntry_ = 0;
+    newestEntry_ = packetCount-1;
+
+    /// At least half the slots are always free, so probes stay short and always end at a free slot
+    slotBits_ = 1;
+    while ((1U << slotBits_) < 2 * packetCount)
+        slotBits_++;
+    entrySlots_.assign(1U << slotBits_, static_cast<unsigned>(noEntry));
+    packetsRead_.reserve(64);
 }
 
 PacketReadCache::~PacketReadCache()
 {
+    stopPrefetch();
+
     /// Free allocated packet buffers
     for (unsigned i=0; i < entries_.size(); i++) {
         delete [] entries_.at(i).buffer_;
@@ -7806,105 +10144,268 @@ PacketReadCache::~PacketReadCache()
     }
 }
 
-auto_ptr<PacketLock> PacketReadCache::lock(uint64_t packetLogicalOffset, char* &pkt)
+PacketLock PacketReadCache::lock(uint64_t packetLogicalOffset, char* &pkt)
 {
 #ifdef E57_MAX_VERBOSE
     cout << "PacketReadCache::lock() called, packetLogicalOffset=" << packetLogicalOffset << endl;
 #endif
 
-    /// Only allow one locked packet at a time.
-    if (lockCount_ > 0)
-        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "lockCount=" + toString(lockCount_));
-
     /// Offset can't be 0
     if (packetLogicalOffset == 0)
         throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "packetLogicalOffset=" + toString(packetLogicalOffset));
 
-    /// Linear scan for matching packet offset in cache
-    for (unsigned i = 0; i < entries_.size(); i++) {
-        if (packetLogicalOffset == entries_[i].logicalOffset_) {
-            /// Found a match, so don't have to read anything
+    /// Any number of packets may be locked at once, as long as one entry is left to read into.
+    unsigned entry = findEntry(packetLogicalOffset);
+    if (entry != noEntry) {
+        /// Found a match, so don't have to read anything
+        hits_++;
+#ifdef E57_MAX_VERBOSE
+        cout << "  Found matching cache entry, index=" << entry << endl;
+#endif
+    } else {
+        /// Find least recently used (LRU) packet buffer that isn't locked
+        entry = oldestEntry_;
+        while (entry != noEntry && entries_[entry].lockCount_ > 0)
+            entry = entries_[entry].newer_;
+        if (entry == noEntry)
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "lockCount=" + toString(lockCount_) + " packetCount=" + toString(entries_.size()));
 #ifdef E57_MAX_VERBOSE
-            cout << "  Found matching cache entry, index=" << i << endl;
+        cout << "  Oldest unlocked entry=" << entry << endl;
 #endif
-            /// Mark entry with current useCount (keeps track of age of entry).
-            entries_[i].lastUsed_ = ++useCount_;
 
-            /// Publish buffer address to caller
-            pkt = entries_[i].buffer_;
+        misses_++;
+
+        /// Forget old contents first, so entry is left empty if read fails
+        setEntryOffset(entry, 0);
+        readPacket(entry, packetLogicalOffset);
+        setEntryOffset(entry, packetLogicalOffset);
+
+        /// Header is native byte order by now, and has the same length field whatever the packet type
+        const EmptyPacketHeader* header = reinterpret_cast<const EmptyPacketHeader*>(entries_[entry].buffer_);
+        if (notePacketRead(packetLogicalOffset, packetLogicalOffset + header->packetLogicalLengthMinus1 + 1))
+            rereads_++;
+    }
+
+    /// Mark entry as most recently used
+    makeNewest(entry);
+
+    /// Publish buffer address to caller
+    pkt = entries_[entry].buffer_;
+
+    /// Increment lock counts just before return.
+    /// The lock returned is on the caller's stack, so we are sure we will be unlocked when use is finished.
+    entries_[entry].lockCount_++;
+    lockCount_++;
+    return(PacketLock(this, entry));
+}
+
+unsigned PacketReadCache::homeSlot(uint64_t packetLogicalOffset)
+{
+    /// Fibonacci hashing: packet offsets are multiples of 4 and about a packet apart, the top bits of the product spread them
+    return(static_cast<unsigned>((packetLogicalOffset * 0x9E3779B97F4A7C15ULL) >> (64 - slotBits_)));
+}
+
+unsigned PacketReadCache::findEntry(uint64_t packetLogicalOffset)
+{
+    /// Linear probe of entrySlots_ from the home slot, returns noEntry if packet isn't in cache
+    unsigned slotMask = (1U << slotBits_) - 1;
+    for (unsigned slot = homeSlot(packetLogicalOffset); ; slot = (slot + 1) & slotMask) {
+        unsigned entry = entrySlots_[slot];
+        if (entry == noEntry || entries_[entry].logicalOffset_ == packetLogicalOffset)
+            return(entry);
+    }
+}
 
-            /// Create lock so we are sure that we will be unlocked when use is finished.
-            auto_ptr<PacketLock> plock(new PacketLock(this, i));
+void PacketReadCache::setEntryOffset(unsigned entry, uint64_t packetLogicalOffset)
+{
+    /// Change which packet entry holds (0 for none), keeping entrySlots_ in step.
+    /// entrySlots_ is a fixed size table, so this doesn't allocate.
+    unsigned slotMask = (1U << slotBits_) - 1;
+    uint64_t oldOffset = entries_[entry].logicalOffset_;
+    if (oldOffset != 0) {
+        unsigned freed = homeSlot(oldOffset);
+        while (entrySlots_[freed] != entry)
+            freed = (freed + 1) & slotMask;
 
-            /// Increment cache lock just before return
-            lockCount_++;
-            return(plock);
+        /// No tombstones: entries after the freed slot whose probe passed through it move back into it
+        for (unsigned slot = (freed + 1) & slotMask; entrySlots_[slot] != noEntry; slot = (slot + 1) & slotMask) {
+            unsigned home = homeSlot(entries_[entrySlots_[slot]].logicalOffset_);
+            if (((slot - home) & slotMask) >= ((slot - freed) & slotMask)) {
+                entrySlots_[freed] = entrySlots_[slot];
+                freed = slot;
+            }
         }
+        entrySlots_[freed] = noEntry;
+    }
+    entries_[entry].logicalOffset_ = packetLogicalOffset;
+    if (packetLogicalOffset != 0) {
+        unsigned slot = homeSlot(packetLogicalOffset);
+        while (entrySlots_[slot] != noEntry)
+            slot = (slot + 1) & slotMask;
+        entrySlots_[slot] = entry;
     }
-    /// Get here if didn't find a match already in cache.
+}
 
-    /// Find least recently used (LRU) packet buffer
-    unsigned oldestEntry = 0;
-    unsigned oldestUsed = entries_.at(0).lastUsed_;
-    for (unsigned i = 0; i < entries_.size(); i++) {
-        if (entries_[i].lastUsed_ < oldestUsed) {
-            oldestEntry = i;
-            oldestUsed = entries_[i].lastUsed_;
+bool PacketReadCache::notePacketRead(uint64_t packetLogicalOffset, uint64_t packetLogicalEnd)
+{
+    /// Add packet to packetsRead_, return true if it was read before.
+    /// Packets don't overlap, so a packet was read before iff its offset falls in an extent already there.
+    /// Reading packets in file order just moves the end of the last extent along.
+    vector<pair<uint64_t, uint64_t> >::iterator next =
+        upper_bound(packetsRead_.begin(), packetsRead_.end(), make_pair(packetLogicalOffset, E57_UINT64_MAX));
+    if (next != packetsRead_.begin()) {
+        vector<pair<uint64_t, uint64_t> >::iterator prev = next - 1;
+        if (packetLogicalOffset < prev->second)
+            return(true);
+        if (prev->second == packetLogicalOffset) {
+            /// Extend previous extent, joining it to next one if packet filled the gap between them
+            prev->second = packetLogicalEnd;
+            if (next != packetsRead_.end() && next->first == packetLogicalEnd) {
+                prev->second = next->second;
+                packetsRead_.erase(next);
+            }
+            return(false);
         }
     }
-#ifdef E57_MAX_VERBOSE
-    cout << "  Oldest entry=" << oldestEntry << " lastUsed=" << oldestUsed << endl;
-#endif
+    if (next != packetsRead_.end() && next->first == packetLogicalEnd)
+        next->first = packetLogicalOffset;
+    else
+        packetsRead_.insert(next, make_pair(packetLogicalOffset, packetLogicalEnd));
+    return(false);
+}
 
-    readPacket(oldestEntry, packetLogicalOffset);
+void PacketReadCache::unlinkEntry(unsigned entry)
+{
+    /// Take entry out of LRU list.
+    CacheEntry& e = entries_[entry];
+    if (e.newer_ != noEntry)
+        entries_[e.newer_].older_ = e.older_;
+    else
+        newestEntry_ = e.older_;
+    if (e.older_ != noEntry)
+        entries_[e.older_].newer_ = e.newer_;
+    else
+        oldestEntry_ = e.newer_;
+}
 
-    /// Publish buffer address to caller
-    pkt = entries_[oldestEntry].buffer_;
+void PacketReadCache::makeNewest(unsigned entry)
+{
+    if (entry == newestEntry_)
+        return;
+    unlinkEntry(entry);
+    entries_[entry].older_ = newestEntry_;
+    entries_[entry].newer_ = noEntry;
+    entries_[newestEntry_].newer_ = entry;
+    newestEntry_ = entry;
+}
 
-    /// Create lock so we are sure we will be unlocked when use is finished.
-    auto_ptr<PacketLock> plock(new PacketLock(this, oldestEntry));
+void PacketReadCache::makeOldest(unsigned entry)
+{
+    if (entry == oldestEntry_)
+        return;
+    unlinkEntry(entry);
+    entries_[entry].newer_ = oldestEntry_;
+    entries_[entry].older_ = noEntry;
+    entries_[oldestEntry_].older_ = entry;
+    oldestEntry_ = entry;
+}
 
-    /// Increment cache lock just before return
-    lockCount_++;
-    return(plock);
+void PacketReadCache::statistics(uint64_t& hits, uint64_t& misses, uint64_t& rereads)
+{
+    hits    = hits_;
+    misses  = misses_;
+    rereads = rereads_;
 }
 
 void PacketReadCache::markDiscarable(uint64_t packetLogicalOffset)
 {
     /// The packet is probably not going to be used again, so mark it as really old.
-
-    /// Linear scan for matching packet offset in cache
-    for (unsigned i = 0; i < entries_.size(); i++) {
-        if (packetLogicalOffset == entries_[i].logicalOffset_) {
-            entries_[i].lastUsed_ = 0;
-            return;
-        }
-    }
+    unsigned entry = findEntry(packetLogicalOffset);
+    if (entry != noEntry)
+        makeOldest(entry);
 }
 
 void PacketReadCache::unlock(unsigned lockedEntry)
 {
-//??? why lockedEntry not used?
 #ifdef E57_MAX_VERBOSE
     cout << "PacketReadCache::unlock() called, lockedEntry=" << lockedEntry << endl;
 #endif
 
-    if (lockCount_ != 1)
-        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "lockCount=" + toString(lockCount_));
+    if (lockedEntry >= entries_.size() || entries_[lockedEntry].lockCount_ == 0)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "lockedEntry=" + toString(lockedEntry) + " lockCount=" + toString(lockCount_));
 
+    entries_[lockedEntry].lockCount_--;
     lockCount_--;
 }
 
+void PacketReadCache::startPrefetch(const ustring& fileName, const CheckedFile::Options& options, unsigned packetCount,
+                                    uint64_t firstPacketLogicalOffset, uint64_t sectionEndLogicalOffset)
+{
+    if (prefetcher_ != NULL)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "fileName=" + fileName);
+    prefetcher_ = new PacketPrefetcher(fileName, options, packetCount, firstPacketLogicalOffset, sectionEndLogicalOffset);
+}
+
+void PacketReadCache::restartPrefetch(uint64_t packetLogicalOffset)
+{
+    if (prefetcher_ != NULL)
+        prefetcher_->restart(packetLogicalOffset);
+}
+
+void PacketReadCache::stopPrefetch()
+{
+    /// Stop read ahead, and account for any pages it read that haven't been reported yet
+    if (prefetcher_ != NULL) {
+        uint64_t pagesRead, pagesChecked;
+        prefetcher_->takePageCounts(pagesRead, pagesChecked);
+        cFile_->addPageCounts(pagesRead, pagesChecked);
+        delete prefetcher_;
+        prefetcher_ = NULL;
+    }
+}
+
+void PacketReadCache::reset()
+{
+    /// Make cache look newly constructed, but keep the packet buffers already allocated
+    if (lockCount_ != 0)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "lockCount=" + toString(lockCount_));
+
+    stopPrefetch();
+    for (unsigned i=0; i < entries_.size(); i++)
+        entries_.at(i).logicalOffset_ = 0;
+    entrySlots_.assign(entrySlots_.size(), static_cast<unsigned>(noEntry));
+    packetsRead_.clear();
+    hits_    = 0;
+    misses_  = 0;
+    rereads_ = 0;
+}
+
 void PacketReadCache::readPacket(unsigned oldestEntry, uint64_t packetLogicalOffset)
 {
 #ifdef E57_MAX_VERBOSE
     cout << "PacketReadCache::readPacket() called, oldestEntry=" << oldestEntry << " packetLogicalOffset=" << packetLogicalOffset << endl;
 #endif
 
+    /// Use packet already read ahead if have it, otherwise read it now.
+    if (prefetcher_ == NULL || !prefetcher_->take(packetLogicalOffset, entries_.at(oldestEntry).buffer_))
+        readPacketFrom(cFile_, packetLogicalOffset, entries_.at(oldestEntry).buffer_);
+
+    /// Pages read ahead count as read by this file, so ImageFile::checksumStatistics sees them.
+    if (prefetcher_ != NULL) {
+        uint64_t pagesRead, pagesChecked;
+        prefetcher_->takePageCounts(pagesRead, pagesChecked);
+        cFile_->addPageCounts(pagesRead, pagesChecked);
+    }
+}
+
+unsigned PacketReadCache::readPacketFrom(CheckedFile* cFile, uint64_t packetLogicalOffset, char* buffer)
+{
+    /// Read packet at packetLogicalOffset into buffer (E57_DATA_PACKET_MAX long), swab and verify it.  Returns packet length.
+    /// Static because PacketPrefetcher calls it on its own thread, with its own CheckedFile.
+
     /// Read header of packet first to get length.  Use EmptyPacketHeader since it has the commom fields to all packets.
     EmptyPacketHeader header;
-    cFile_->seek(packetLogicalOffset, CheckedFile::logical);
-    cFile_->read(reinterpret_cast<char*>(&header), sizeof(header));
+    cFile->readAt(packetLogicalOffset, reinterpret_cast<char*>(&header), sizeof(header));
     header.swab();
     /// Can't verify packet header here, because it is not really an EmptyPacketHeader.
     unsigned packetLength = header.packetLogicalLengthMinus1+1;
@@ -7914,13 +10415,12 @@ void PacketReadCache::readPacket(unsigned oldestEntry, uint64_t packetLogicalOff
         throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetLength=" + toString(packetLength));
 
     /// Now read in whole packet into preallocated buffer_.  Note buffer is
-    cFile_->seek(packetLogicalOffset, CheckedFile::logical);
-    cFile_->read(entries_.at(oldestEntry).buffer_, packetLength);
+    cFile->readAt(packetLogicalOffset, buffer, packetLength, true);
 
     /// Swab if necessary, then verify that packet is good.
     switch (header.packetType) {
         case E57_DATA_PACKET: {
-                DataPacket* dpkt = reinterpret_cast<DataPacket*>(entries_.at(oldestEntry).buffer_);
+                DataPacket* dpkt = reinterpret_cast<DataPacket*>(buffer);
 #ifdef E57_BIGENDIAN
                 dpkt->swab(false);
 #endif
@@ -7932,7 +10432,7 @@ void PacketReadCache::readPacket(unsigned oldestEntry, uint64_t packetLogicalOff
             }
             break;
         case E57_INDEX_PACKET: {
-                IndexPacket* ipkt = reinterpret_cast<IndexPacket*>(entries_.at(oldestEntry).buffer_);
+                IndexPacket* ipkt = reinterpret_cast<IndexPacket*>(buffer);
 #ifdef E57_BIGENDIAN
                 ipkt->swab(false);
 #endif
@@ -7944,7 +10444,7 @@ void PacketReadCache::readPacket(unsigned oldestEntry, uint64_t packetLogicalOff
             }
             break;
         case E57_EMPTY_PACKET: {
-                EmptyPacketHeader* hp = reinterpret_cast<EmptyPacketHeader*>(entries_.at(oldestEntry).buffer_);
+                EmptyPacketHeader* hp = reinterpret_cast<EmptyPacketHeader*>(buffer);
                 hp->swab();
                 hp->verify(packetLength);
 #ifdef E57_MAX_VERBOSE
@@ -7956,24 +10456,25 @@ void PacketReadCache::readPacket(unsigned oldestEntry, uint64_t packetLogicalOff
         default:
             throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "packetType=" + toString(header.packetType));
     }
-
-    entries_[oldestEntry].logicalOffset_ = packetLogicalOffset;
-
-    /// Mark entry with current useCount (keeps track of age of entry).
-    /// This is a cache, so a small hiccup when useCount_ overflows won't hurt.
-    entries_[oldestEntry].lastUsed_ = ++useCount_;
+    return(packetLength);
 }
 
 #ifdef E57_DEBUG
 void PacketReadCache::dump(int indent, std::ostream& os)
 {
-    os << space(indent) << "lockCount: " << lockCount_ << endl;
-    os << space(indent) << "useCount:  " << useCount_ << endl;
+    os << space(indent) << "lockCount:   " << lockCount_ << endl;
+    os << space(indent) << "newestEntry: " << newestEntry_ << endl;
+    os << space(indent) << "oldestEntry: " << oldestEntry_ << endl;
+    os << space(indent) << "hits:        " << hits_ << endl;
+    os << space(indent) << "misses:      " << misses_ << endl;
+    os << space(indent) << "rereads:     " << rereads_ << endl;
     os << space(indent) << "entries:" << endl;
     for (unsigned i=0; i < entries_.size(); i++) {
         os << space(indent) << "entry[" << i << "]:" << endl;
         os << space(indent+4) << "logicalOffset:  " << entries_[i].logicalOffset_ << endl;
-        os << space(indent+4) << "lastUsed:        " << entries_[i].lastUsed_ << endl;
+        os << space(indent+4) << "lockCount:      " << entries_[i].lockCount_ << endl;
+        os << space(indent+4) << "newer:          " << entries_[i].newer_ << endl;
+        os << space(indent+4) << "older:          " << entries_[i].older_ << endl;
         if (entries_[i].logicalOffset_ != 0) {
             os << space(indent+4) << "packet:" << endl;
             switch (reinterpret_cast<EmptyPacketHeader*>(entries_.at(i).buffer_)->packetType) {
@@ -8061,6 +10562,119 @@ void DecodeChannel::dump(int indent, std::ostream& os)
 
 //================================================================
 
+WorkerPool::WorkerPool(unsigned threadCount)
+: task_(NULL),
+  taskCount_(0),
+  nextTask_(0),
+  doneCount_(0),
+  generation_(0),
+  shutdown_(false)
+{
+    for (unsigned i = 0; i < threadCount; i++)
+        threads_.push_back(std::thread(&WorkerPool::workerMain, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    wakeWorkers_.notify_all();
+    for (unsigned i = 0; i < threads_.size(); i++)
+        threads_[i].join();
+}
+
+void WorkerPool::run(unsigned taskCount, const std::function<void (unsigned)>& task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    /// Publish the new set of tasks, and wake up workers to help
+    task_      = &task;
+    taskCount_ = taskCount;
+    nextTask_  = 0;
+    doneCount_ = 0;
+    error_     = std::exception_ptr();
+    generation_++;
+    if (taskCount > 1)
+        wakeWorkers_.notify_all();
+
+    /// Take tasks ourselves, then wait for any still running on workers.
+    runTasks(lock);
+    tasksDone_.wait(lock, [this] {return(doneCount_ == taskCount_);});
+    task_ = NULL;
+
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkerPool::workerMain()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    unsigned seenGeneration = generation_;
+    while (1) {
+        wakeWorkers_.wait(lock, [this, &seenGeneration] {return(shutdown_ || generation_ != seenGeneration);});
+        if (shutdown_)
+            return;
+        seenGeneration = generation_;
+        runTasks(lock);
+    }
+}
+
+void WorkerPool::runTasks(std::unique_lock<std::mutex>& lock)
+{
+    /// Called with lock held, mutex is released while each task runs.
+    while (nextTask_ < taskCount_) {
+        unsigned taskIndex = nextTask_++;
+        std::exception_ptr error;
+        lock.unlock();
+        try {
+            (*task_)(taskIndex);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        /// Keep the first exception to be rethrown by run()
+        if (error && !error_)
+            error_ = error;
+        if (++doneCount_ == taskCount_)
+            tasksDone_.notify_all();
+    }
+}
+
+//================================================================
+
+MemoryBudget::MemoryBudget(uint64_t limit)
+: limit_(limit),
+  used_(0),
+  holders_(0)
+{
+}
+
+void MemoryBudget::acquire(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [this, bytes] {return(holders_ == 0 || (used_ <= limit_ && bytes <= limit_ - used_));});
+    used_ += bytes;
+    holders_++;
+}
+
+void MemoryBudget::release(uint64_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        used_ -= bytes;
+        holders_--;
+    }
+    released_.notify_all();
+}
+
+//================================================================
+
 template <typename RegisterT>
 BitpackIntegerEncoder<RegisterT>::BitpackIntegerEncoder(bool isScaledInteger, unsigned bytestreamNumber, SourceDestBuffer& sbuf,
                                                        unsigned outputMaxSize, int64_t minimum, int64_t maximum, double scale, double offset)
@@ -8119,15 +10733,26 @@ uint64_t BitpackIntegerEncoder<RegisterT>::processRecords(size_t recordCount)
     RegisterT* outp = reinterpret_cast<RegisterT*>(&outBuffer_[outBufferEnd_]);
     unsigned outTransferred = 0;
 
+    /// Source values are fetched a chunk at a time with the bulk routines
+    int64_t rawValues[SourceDestBufferImpl::arrayChunkSize];
+    size_t chunkIndex = 0;
+    size_t chunkCount = 0;
+
     /// Copy bits from sourceBuffer_ to outBuffer_
     for (unsigned i=0; i < recordCount; i++) {
-        int64_t rawValue;
-
-        /// The parameter isScaledInteger_ determines which version of getNextInt64 gets called
-        if (isScaledInteger_)
-            rawValue = sourceBuffer_->getNextInt64(scale_, offset_);
-        else
-            rawValue = sourceBuffer_->getNextInt64();
+        if (chunkIndex == chunkCount) {
+            chunkCount = recordCount - i;
+            if (chunkCount > SourceDestBufferImpl::arrayChunkSize)
+                chunkCount = SourceDestBufferImpl::arrayChunkSize;
+            chunkIndex = 0;
+
+            /// The parameter isScaledInteger_ determines which version of getNextInt64Array gets called
+            if (isScaledInteger_)
+                sourceBuffer_->getNextInt64Array(rawValues, chunkCount, scale_, offset_);
+            else
+                sourceBuffer_->getNextInt64Array(rawValues, chunkCount);
+        }
+        int64_t rawValue = rawValues[chunkIndex++];
 
         /// Enforce min/max specification on value
         if (rawValue < minimum_ || maximum_ < rawValue) {
@@ -8360,6 +10985,124 @@ void ConstantIntegerEncoder::dump(int indent, std::ostream& os)
 }
 #endif
 
+//================================================================
+// Bit unpacking kernels for BitpackIntegerDecoder
+//
+// On a little endian machine a bitpacked bytestream is one long little endian bit string, whatever register size was used to write it.
+// So record i of a run starts at bit firstBit + i*bits, and can be fetched with a single unaligned 8 byte load and a shift,
+// as long as bits <= 56 (so value plus its offset in the first byte fit in the 64 bit load).
+// Loads touch up to 7 bytes past the end of the last record, the caller must have readable memory there (see BitpackDecoder::inBufferGuardSize).
+// Uses AVX2 (four records per step, gather + variable shift) if the CPU has it (checked once at run-time), otherwise a scalar loop.
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#  define E57_UNPACK_AVX2 1
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+const unsigned unpackMaxBits = 56;
+
+void unpackScalar(const char* inbuf, size_t firstBit, size_t count, unsigned bits, int64_t minimum, int64_t* out)
+{
+    const uint64_t mask = (1ULL << bits) - 1;
+    size_t bit = firstBit;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t w;
+        memcpy(&w, &inbuf[bit >> 3], 8);
+        /// Add in unsigned, like the register loop does, so wrap around is defined
+        out[i] = static_cast<int64_t>(static_cast<uint64_t>(minimum) + ((w >> (bit & 7)) & mask));
+        bit += bits;
+    }
+}
+
+#ifdef E57_UNPACK_AVX2
+__attribute__((target("avx2")))
+void unpackAvx2(const char* inbuf, size_t firstBit, size_t count, unsigned bits, int64_t minimum, int64_t* out)
+{
+    const __m256i mask     = _mm256_set1_epi64x(static_cast<long long>((1ULL << bits) - 1));
+    const __m256i minimum4 = _mm256_set1_epi64x(minimum);
+    const __m256i seven    = _mm256_set1_epi64x(7);
+    const __m256i step     = _mm256_set1_epi64x(4LL * bits);
+    const long long* base  = reinterpret_cast<const long long*>(inbuf);
+
+    /// Bit position of the four records in flight
+    __m256i bit4 = _mm256_setr_epi64x(firstBit, firstBit + bits, firstBit + 2*bits, firstBit + 3*bits);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i w = _mm256_i64gather_epi64(base, _mm256_srli_epi64(bit4, 3), 1);
+        w = _mm256_srlv_epi64(w, _mm256_and_si256(bit4, seven));
+        w = _mm256_add_epi64(_mm256_and_si256(w, mask), minimum4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[i]), w);
+        bit4 = _mm256_add_epi64(bit4, step);
+    }
+    unpackScalar(inbuf, firstBit + i*bits, count - i, bits, minimum, &out[i]);
+}
+#endif
+
+bool unpackAvx2Available()
+{
+#ifdef E57_UNPACK_AVX2
+    static const bool available = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+    return(available);
+#else
+    return(false);
+#endif
+}
+
+/// Unpack count records of bits each (1..unpackMaxBits), starting at firstBit of inbuf, into out, adding minimum to each.
+void unpackBits(const char* inbuf, size_t firstBit, size_t count, unsigned bits, int64_t minimum, int64_t* out)
+{
+#ifdef E57_UNPACK_AVX2
+    if (unpackAvx2Available()) {
+        unpackAvx2(inbuf, firstBit, count, bits, minimum, out);
+        return;
+    }
+#endif
+    unpackScalar(inbuf, firstBit, count, bits, minimum, out);
+}
+
+}
+
+#ifdef UNPACK_UNIT_TEST
+
+int main()
+{
+    /// Compare against a bit at a time reference, for every width, start bit, and run lengths around the vector step
+    vector<char> data(1024 + 8);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<char>(rand());
+    const int64_t minimums[] = {0, -1000, E57_INT64_MIN/2};
+
+    for (unsigned bits = 1; bits <= unpackMaxBits; bits++) {
+        for (size_t firstBit = 0; firstBit < 64; firstBit++) {
+            for (size_t count = 0; count < 40; count++) {
+                for (unsigned m = 0; m < 3; m++) {
+                    int64_t out[40], outScalar[40];
+                    unpackBits(&data[0], firstBit, count, bits, minimums[m], out);
+                    unpackScalar(&data[0], firstBit, count, bits, minimums[m], outScalar);
+                    for (size_t i = 0; i < count; i++) {
+                        uint64_t expected = 0;
+                        for (unsigned b = 0; b < bits; b++) {
+                            size_t bit = firstBit + i*bits + b;
+                            expected |= static_cast<uint64_t>((data[bit/8] >> (bit%8)) & 1) << b;
+                        }
+                        expected += static_cast<uint64_t>(minimums[m]);
+                        if (out[i] != static_cast<int64_t>(expected) || outScalar[i] != static_cast<int64_t>(expected)) {
+                            std::cout << "OOPS: bits=" << bits << " firstBit=" << firstBit << " count=" << count << " i=" << i << endl;
+                            exit(-1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    std::cout << "unpack OK, avx2=" << unpackAvx2Available() << endl;
+    return(0);
+}
+
+#endif
+
 //================================================================
 
 template <typename RegisterT>
@@ -8376,6 +11119,29 @@ BitpackIntegerDecoder<RegisterT>::BitpackIntegerDecoder(bool isScaledInteger, un
     offset_             = offset;
     bitsPerRecord_      = imf->bitsNeeded(minimum_, maximum_);
     destBitMask_        = (bitsPerRecord_==64) ? ~0 : (1ULL<<bitsPerRecord_)-1;
+    selectArrayStore();
+}
+
+template <typename RegisterT>
+void BitpackIntegerDecoder<RegisterT>::destBufferSetNew(vector<SourceDestBuffer>& dbufs)
+{
+    /// New buffer may want different conversion (e.g. not scaled), so pick its store again
+    BitpackDecoder::destBufferSetNew(dbufs);
+    selectArrayStore();
+}
+
+template <typename RegisterT>
+void BitpackIntegerDecoder<RegisterT>::selectArrayStore()
+{
+    /// A damaged file can hold any value of bitsPerRecord_ bits, not just up to maximum_,
+    /// so a specialized store (which doesn't range check) is picked for every value the bits can give.
+    arrayStore_ = NULL;
+    if (bitsPerRecord_ > unpackMaxBits)
+        return;
+    uint64_t span = static_cast<uint64_t>(destBitMask_);
+    if (minimum_ > E57_INT64_MAX - static_cast<int64_t>(span))
+        return;
+    arrayStore_ = destBuffer_->int64ArrayStore(minimum_, minimum_ + static_cast<int64_t>(span), isScaledInteger_, scale_, offset_);
 }
 
 template <typename RegisterT>
@@ -8418,6 +11184,35 @@ size_t BitpackIntegerDecoder<RegisterT>::inputProcessAligned(const char* inbuf,
     cout << "  recordCount=" << recordCount << endl; //???
 #endif
 
+#if !defined(E57_BIGENDIAN) && !defined(E57_MAX_VERBOSE)
+    /// Fast path: unpack runs of records into a lane buffer with the (possibly SIMD) kernel, then store them.
+    if (bitsPerRecord_ <= unpackMaxBits) {
+        int64_t lanes[unpackLaneCount];
+        for (size_t done = 0; done < recordCount; ) {
+            size_t runCount = recordCount - done;
+            if (runCount > unpackLaneCount)
+                runCount = unpackLaneCount;
+            unpackBits(inbuf, firstBit + done*bitsPerRecord_, runCount, bitsPerRecord_, minimum_, lanes);
+
+            /// Store compiled for this buffer's representation and conversion if there is one, else the general routine.
+            /// The parameter isScaledInteger_ determines which version of setNextInt64Array gets called
+            if (arrayStore_ != NULL)
+                arrayStore_(destBuffer_.get(), lanes, runCount, scale_, offset_);
+            else if (isScaledInteger_)
+                destBuffer_->setNextInt64Array(lanes, runCount, scale_, offset_);
+            else
+                destBuffer_->setNextInt64Array(lanes, runCount);
+            done += runCount;
+        }
+
+        /// Update counts of records processed
+        currentRecordIndex_ += recordCount;
+
+        /// Return number of bits processed.
+        return(recordCount * bitsPerRecord_);
+    }
+#endif
+
     const RegisterT* inp = reinterpret_cast<const RegisterT*>(inbuf);
     unsigned wordPosition = 0;      /// The index in inbuf of the word we are currently working on.
 
@@ -8510,3 +11305,153 @@ void BitpackIntegerDecoder<RegisterT>::dump(int indent, std::ostream& os)
 }
 #endif
 
+#ifdef ALLOCATION_UNIT_TEST
+
+#include <new>
+
+/// Every heap allocation made while allocationCounting is set is counted, on any thread
+static std::atomic<bool>     allocationCounting(false);
+static std::atomic<uint64_t> allocationCount(0);
+
+void* operator new(size_t size)
+{
+    if (allocationCounting)
+        allocationCount++;
+    void* p = malloc(size ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return(p);
+}
+
+void* operator new[](size_t size)
+{
+    return(operator new(size));
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+int main()
+{
+    /// Once the first blocks have set everything up, writing and reading more blocks of a scan mustn't allocate.
+    /// Each configuration has its own steady state: serial, encoding/decoding in parallel, read ahead,
+    /// and writes in the background alternating between two sets of buffers (see writeAsync).
+    const char* writeConfigurations[] = {"", "encodeThreads=3", "", "", "encodeThreads=3"};
+    const char* readConfigurations[]  = {"", "threads=3", "prefetch=4", "", "threads=3"};
+    const bool  asyncConfigurations[] = {false, false, false, true, true};
+    const unsigned configurationCount = sizeof(asyncConfigurations) / sizeof(asyncConfigurations[0]);
+    const size_t   blockSize = 10000;
+    const unsigned blockCount = 20;
+    const unsigned setupBlockCount = 2;
+
+    for (unsigned c = 0; c < configurationCount; c++) {
+        vector<double>  x[2], y[2];
+        vector<float>   intensity[2];
+        vector<int32_t> row[2];
+        for (unsigned s = 0; s < 2; s++) {
+            x[s].resize(blockSize);
+            y[s].resize(blockSize);
+            intensity[s].resize(blockSize);
+            row[s].resize(blockSize);
+        }
+        {
+            ImageFile imf("allocationTest.e57", "w", writeConfigurations[c]);
+            VectorNode data3D(imf, true);
+            imf.root().set("data3D", data3D);
+            StructureNode scan(imf);
+            data3D.append(scan);
+            StructureNode proto(imf);
+            proto.set("cartesianX", ScaledIntegerNode(imf, 0, -1000000, 1000000, 0.001, 0));
+            proto.set("cartesianY", FloatNode(imf, 0, E57_DOUBLE));
+            proto.set("intensity",  FloatNode(imf, 0, E57_SINGLE));
+            proto.set("rowIndex",   IntegerNode(imf, 0, 0, 1<<20));
+            CompressedVectorNode points(imf, proto, VectorNode(imf, true));
+            scan.set("points", points);
+
+            vector<SourceDestBuffer> sbufs[2];
+            for (unsigned s = 0; s < 2; s++) {
+                sbufs[s].push_back(SourceDestBuffer(imf, "cartesianX", &x[s][0],         blockSize, true, true));
+                sbufs[s].push_back(SourceDestBuffer(imf, "cartesianY", &y[s][0],         blockSize, true));
+                sbufs[s].push_back(SourceDestBuffer(imf, "intensity",  &intensity[s][0], blockSize, true));
+                sbufs[s].push_back(SourceDestBuffer(imf, "rowIndex",   &row[s][0],       blockSize, true));
+            }
+            CompressedVectorWriter writer = points.writer(sbufs[0]);
+            for (unsigned b = 0; b < blockCount; b++) {
+                /// A background write is still running while the other set is filled, so count from here on,
+                /// once the writes of the setup blocks are over
+                unsigned s = asyncConfigurations[c] ? b % 2 : 0;
+                if (b == setupBlockCount)
+                    writer.waitForWrite();
+                allocationCounting = (b >= setupBlockCount);
+                for (size_t i = 0; i < blockSize; i++) {
+                    size_t recordNumber = b*blockSize + i;
+                    x[s][i]         = (recordNumber % 2000) * 0.25 - 250;
+                    y[s][i]         = sin(recordNumber * 0.001);
+                    intensity[s][i] = recordNumber * 0.5f;
+                    row[s][i]       = static_cast<int32_t>(recordNumber % (1<<20));
+                }
+                if (asyncConfigurations[c])
+                    writer.writeAsync(sbufs[s], blockSize);
+                else {
+                    writer.write(blockSize);
+                    allocationCounting = false;
+                }
+            }
+            writer.waitForWrite();
+            allocationCounting = false;
+            writer.close();
+            imf.close();
+        }
+        uint64_t writeAllocationCount = allocationCount;
+        allocationCount = 0;
+
+        uint64_t recordCount = 0;
+        {
+            ImageFile imf("allocationTest.e57", "r", readConfigurations[c]);
+            CompressedVectorNode points(StructureNode(VectorNode(imf.root().get("/data3D")).get(0)).get("points"));
+            vector<SourceDestBuffer> dbufs;
+            dbufs.push_back(SourceDestBuffer(imf, "cartesianX", &x[0][0],         blockSize, true, true));
+            dbufs.push_back(SourceDestBuffer(imf, "cartesianY", &y[0][0],         blockSize, true));
+            dbufs.push_back(SourceDestBuffer(imf, "intensity",  &intensity[0][0], blockSize, true));
+            dbufs.push_back(SourceDestBuffer(imf, "rowIndex",   &row[0][0],       blockSize, true));
+            CompressedVectorReader reader = points.reader(dbufs);
+            for (unsigned b = 0; ; b++) {
+                allocationCounting = (b >= setupBlockCount);
+                unsigned n = reader.read();
+                allocationCounting = false;
+                if (n == 0)
+                    break;
+                /// Every record is checked, a block written from the wrong set of buffers would show
+                for (unsigned i = 0; i < n; i++) {
+                    if (row[0][i] != static_cast<int32_t>((recordCount + i) % (1<<20))) {
+                        std::cout << "OOPS: configuration=" << c << " bad record " << recordCount + i << endl;
+                        exit(-1);
+                    }
+                }
+                recordCount += n;
+            }
+            reader.close();
+            imf.close();
+        }
+        uint64_t readAllocationCount = allocationCount;
+        allocationCount = 0;
+        _unlink("allocationTest.e57");
+
+        if (recordCount != blockCount*blockSize || writeAllocationCount != 0 || readAllocationCount != 0) {
+            std::cout << "OOPS: configuration=" << c << " recordCount=" << recordCount
+                      << " writeAllocationCount=" << writeAllocationCount << " readAllocationCount=" << readAllocationCount << endl;
+            exit(-1);
+        }
+    }
+    std::cout << "allocations OK" << endl;
+    return(0);
+}
+
+#endif
@@ -41,7 +41,12 @@
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
-#include <boost/crc.hpp>        // for boost::crc_optimal
+#include <functional>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 // Define the following symbol adds some functions to the API for implementation purposes.
 // These functions are not available to a normal API user.
@@ -164,6 +169,7 @@ template <typename RegisterT> class BitpackIntegerEncoder;
 template <typename RegisterT> class BitpackIntegerDecoder;
 class E57XmlParser;
 class Encoder;
+class PacketReadCache;
 
 /// Version numbers of ASTM standard that this library supports
 const uint32_t E57_FORMAT_MAJOR = 1;			//Changed from 0 to 1 by SC
@@ -214,15 +220,36 @@ class CheckedFile {
 public:
     enum Mode {readOnly, writeCreate, writeExisting};
     enum OffsetMode {logical, physical};
+
+    /// Which pages read from the file get their checksum verified.
+    /// Headers means the XML section, binary section headers and the page holding each packet header,
+    /// i.e. everything except bulk data (packet contents and blob bytes).
+    /// Sampled verifies all headers, plus a pseudo-random fixed percentage of bulk data pages.
+    enum ChecksumPolicy {checksumAll, checksumHeaders, checksumSampled, checksumNone};
+
+    /// Tuning options, parsed from the ImageFile configuration string (see ImageFileImpl::parseConfiguration)
+    struct Options {
+        bool            useMemoryMap;           // readOnly files: map whole file instead of pread per batch of pages
+        ChecksumPolicy  checksumPolicy;
+        unsigned        checksumSamplePercent;  // checksumSampled: percent of bulk data pages verified
+                        Options() : useMemoryMap(false), checksumPolicy(checksumAll), checksumSamplePercent(100) {};
+    };
+
     static const size_t   physicalPageSizeLog2;  // physical page size is 2 raised to this power
     static const size_t   physicalPageSize;
     static const uint64_t physicalPageSizeMask;
     static const size_t   logicalPageSize;
 
-                    CheckedFile(ustring fileName, Mode mode);
+                    CheckedFile(ustring fileName, Mode mode, const Options& options = Options());
                     ~CheckedFile();
 
     void            read(char* buf, size_t nRead, size_t bufSize = 0);
+    void            readBulkData(char* buf, size_t nRead);
+
+    /// Read at given logical offset, without using or moving the file cursor.
+    /// Several threads may call this at once on a readOnly file.
+    /// The cursor used by read(), write() and seek() is just a member, so those calls are for one thread only.
+    void            readAt(uint64_t logicalOffset, char* buf, size_t nRead, bool isBulkData = false);
     //???void       write(char* buf, size_t nWrite, size_t bufSize = 0);
     void            write(const char* buf, size_t nWrite);
     CheckedFile&    operator<<(const ustring& s);
@@ -241,10 +268,25 @@ public:
 
     static size_t   efficientBufferSize(size_t logicalSize);  //??? needed?
 
+    /// Direct access to checksum-verified logical pages of a memory mapped file
+    bool            isMapped() {return(mapBase_ != NULL);};
+    const char*     pageView(uint64_t page, size_t pageCount = 1, bool isBulkData = false);
+
+    /// Pages passed through read() so far, and how many of those had their checksum verified
+    uint64_t        pagesReadCount() {return(pagesRead_);};
+    uint64_t        pagesCheckedCount() {return(pagesChecked_);};
+    void            addPageCounts(uint64_t pagesRead, uint64_t pagesChecked) {pagesRead_ += pagesRead; pagesChecked_ += pagesChecked;};
+
     static inline uint64_t logicalToPhysical(uint64_t logicalOffset);
     static inline uint64_t physicalToLogical(uint64_t physicalOffset);
 private:
-    uint32_t        checksum(char* buf, size_t size);
+    uint32_t        checksum(const char* buf, size_t size);
+    void            readPages(char* buf, size_t nRead, bool isBulkData);
+    bool            checksumWanted(uint64_t page, bool isBulkData);
+    void            checkPages(const char* page_buffer, uint64_t page, size_t pageCount, bool isBulkData);
+    void            verifyPages(const char* page_buffer, uint64_t page, size_t pageCount);
+    void            mapFile();
+    void            unmapFile();
 template<class FTYPE>
     CheckedFile&    writeFloatingPoint(FTYPE value, int precision);
 
@@ -252,18 +294,45 @@ template<class FTYPE>
     int             fd_;
     bool            readOnly_;
     uint64_t        logicalLength_;
-    boost::crc_optimal<32,          // bits
-                       0x1EDC6F41,  // truncated polynomial, iSCSI
-                       0xFFFFFFFF,  // initial remainder
-                       0xFFFFFFFF,  // final xor value
-                       true,        // reflect input
-                       true         // reflect remainder
-                      > crcCalculator_;
+
+    /// Physical cursor.  All file access is positioned (pread/pwrite), the OS file offset isn't used.
+    uint64_t        position_;
+
+    /// Memory mapped image of a readOnly file, NULL if using pread
+    char*           mapBase_;
+    uint64_t        mapLength_;     // physical length of mapping
+    std::vector<std::atomic<bool> > mapPageVerified_;
+
+    ChecksumPolicy  checksumPolicy_;
+    unsigned        checksumSamplePercent_;
+    std::atomic<uint64_t> pagesRead_;
+    std::atomic<uint64_t> pagesChecked_;
+
+    /// Physical length of a readOnly file, noted when opened since it can't change
+    uint64_t        readOnlyLength_;
+#if defined(WIN32)
+    std::mutex      ioMutex_;       // no pread()/pwrite(), so each seek+read or seek+write pair has to be done under lock
+#endif
+
+    /// Write-behind buffer of consecutive physical pages, normally the tail of the file being appended to.
+    /// Page checksums are filled in once, and the whole run written with a single call, when it is flushed.
+    static const size_t writeBufferPages;
+    std::vector<char> writeBuffer_;
+    uint64_t        writeBufferFirstPage_;
+    size_t          writeBufferPageCount_;
+
+    /// Page read-modify-written by write() when backpatching a page that has left the write buffer, kept for reuse
+    std::vector<char> backpatchPage_;
 
 #ifdef SAFE_MODE
     void        getCurrentPageAndOffset(uint64_t& page, size_t& pageOffset, OffsetMode omode = logical);
     void        readPhysicalPage(char* page_buffer, uint64_t page);
+    void        readPhysicalPages(char* page_buffer, uint64_t page, size_t pageCount, bool isBulkData = false);
+    void        readPhysical(char* buf, size_t nRead, uint64_t physicalOffset);
+    void        writePhysical(const char* buf, size_t nWrite, uint64_t physicalOffset);
     void        writePhysicalPage(char* page_buffer, uint64_t page);
+    char*       bufferedPage(uint64_t page);
+    void        flushWriteBuffer();
     int         open64(ustring fileName, int flags, int mode);
     uint64_t    lseek64(int64_t offset, int whence);
 #else
@@ -460,6 +529,25 @@ public:
     void            setNextDouble(double value);
     void            setNextString(const ustring& value);
 
+    /// Bulk get/set: same conversions and errors as above, but capacity, representation and stride are resolved once per call.
+    void            getNextInt64Array(int64_t* values, size_t count);
+    void            getNextInt64Array(int64_t* values, size_t count, double scale, double offset);
+    void            getNextFloatArray(float* values, size_t count);
+    void            getNextDoubleArray(double* values, size_t count);
+    void            setNextInt64Array(const int64_t* values, size_t count);
+    void            setNextInt64Array(const int64_t* values, size_t count, double scale, double offset);
+    void            setNextFloatArray(const float* values, size_t count);
+    void            setNextDoubleArray(const double* values, size_t count);
+
+    /// Number of values the bulk routines stage at a time, also a good size for callers' own staging arrays
+    static const size_t arrayChunkSize = 256;
+
+    /// Store for decoded integers known to lie in [minimum, maximum], compiled for one representation and conversion,
+    /// so it has no per value switch or range check.  int64ArrayStore() picks it once, for a decoder's values and this buffer.
+    /// Returns NULL if a value could fail to convert, then setNextInt64Array() must be used, to get its errors.
+    typedef void    (*Int64ArrayStore)(SourceDestBufferImpl* dbuf, const int64_t* values, size_t count, double scale, double offset);
+    Int64ArrayStore int64ArrayStore(int64_t minimum, int64_t maximum, bool isScaledInteger, double scale, double offset);
+
     void            checkCompatible(boost::shared_ptr<SourceDestBufferImpl> newBuf);
 
 #ifdef E57_DEBUG
@@ -480,6 +568,18 @@ friend class BitpackIntegerDecoder<uint32_t>;  //??? needed?
 friend class BitpackIntegerDecoder<uint64_t>;  //??? needed?
 
     void                    checkState_();  /// Common routine to check that constructor arguments were ok, throws if not
+    void                    checkArrayRoom_(size_t count);
+    template <typename T, typename V>
+    void                    storeArray_(const V* values, size_t count);
+    template <typename T, typename V>
+    void                    storeArrayInRange_(const V* values, size_t count, V lo, V hi, ErrorCode ecode, const char* valueName);
+    template <typename T, typename V>
+    void                    loadArray_(V* values, size_t count);
+    enum Int64Conversion {rawInt64, scaledInt64, roundedScaledInt64};
+    template <typename T, Int64Conversion conversion>
+    static T                convertInt64_(int64_t value, double scale, double offset);
+    template <typename T, Int64Conversion conversion>
+    static void             storeInt64ArrayAs_(SourceDestBufferImpl* dbuf, const int64_t* values, size_t count, double scale, double offset);
 
     //??? verify alignment
     boost::weak_ptr<ImageFileImpl> destImageFile_;
@@ -735,6 +835,19 @@ class ImageFileImpl : public boost::enable_shared_from_this<ImageFileImpl> {
 public:
 					ImageFileImpl();
 	void			construct2(const ustring& fileName, const ustring& mode, const ustring& configuration);
+
+    /// Tuning options, parsed from the ImageFile configuration string (see parseConfiguration)
+    struct Options {
+        CheckedFile::Options file;
+        unsigned        decodeThreads;          // CompressedVectorReader decoding threads, 1 is serial
+        unsigned        encodeThreads;          // CompressedVectorWriter encoding threads, 1 is serial
+        unsigned        prefetchPackets;        // CompressedVectorReader background read-ahead, 0 is off
+        unsigned        cachePackets;           // CompressedVectorReader packet cache size, 0 is sized from field count
+        uint64_t        indexChunkRecords;      // CompressedVectorWriter records per index chunk, multiple of 64, 0 writes no index
+                        Options() : decodeThreads(1), encodeThreads(1), prefetchPackets(0), cachePackets(0), indexChunkRecords(65536) {};
+    };
+    static void     parseConfiguration(const ustring& configuration, Options& options);
+    const Options&  options()   {return(options_);}
     boost::shared_ptr<StructureNodeImpl> root();
     void            close();
     void            cancel();
@@ -747,6 +860,16 @@ public:
     uint64_t        allocateSpace(uint64_t byteCount, bool doExtendNow);
     CheckedFile*    file();
     ustring         fileName();
+    void            checksumStatistics(uint64_t& pagesRead, uint64_t& pagesChecked);
+
+    /// Packet caches for CompressedVectorReaders. A closed reader's cache is kept as a spare,
+    /// so reading scan after scan from one open file doesn't reallocate the packet buffers each time.
+    PacketReadCache* acquireReadCache(unsigned packetCount);
+    void            releaseReadCache(PacketReadCache* cache);
+
+    /// Run read jobs on several threads at once, see ImageFile::readConcurrently
+    void            readConcurrently(const std::vector<ReadTask>& tasks, unsigned threadCount, uint64_t memoryLimit);
+    uint64_t        readerMemoryEstimate(unsigned channelCount);
 
     /// Manipulate registered extensions in the file
     void            extensionsAdd(const ustring& prefix, const ustring& uri);
@@ -789,6 +912,7 @@ protected: //=================
     friend class CompressedVectorReaderImpl; //??? add file() instead of accessing file_, others friends too
 
     void checkImageFileOpen(const char* srcFileName, int srcLineNumber, const char* srcFunctionName);
+    void freeSpareReadCaches();
 
     struct NameSpace {
         ustring     prefix;
@@ -804,6 +928,13 @@ protected: //=================
     int             readerCount_;
 
     CheckedFile*    file_;
+    Options         options_;
+
+    /// Caches released by closed readers, all idle and read through file_
+    std::vector<PacketReadCache*> spareReadCaches_;
+
+    /// Readers may be opened and closed on different threads (see readConcurrently), guards readerCount_ and spareReadCaches_
+    std::mutex      readersMutex_;
 
     /// Read file attributes
     uint64_t        xmlLogicalOffset_;
@@ -812,6 +943,11 @@ protected: //=================
     /// Write file attributes
     uint64_t        unusedLogicalStart_;
 
+    /// Binary sections are written through one file cursor at the end of space allocated so far. A CompressedVectorWriter
+    /// may write on its own thread (see writeAsync), so seeks and writes to binary sections hold this. allocateSpace() doesn't
+    /// lock it itself: callers must hold binaryWriteMutex_ around allocateSpace() and the writes into the space it returns.
+    std::mutex      binaryWriteMutex_;
+
     /// Bidirectional map from namespace prefix to uri
     std::vector<NameSpace>  nameSpaces_;
 
@@ -822,12 +958,53 @@ protected: //=================
 //================================================================
 
 
+class PacketReadCache;
+
+/// Finds where records start in the data packets of a CompressedVector binary section, for CompressedVectorReaderImpl::seek().
+/// If the section has index packets, they give the data packet that starts the chunk holding a record, and the
+/// packet headers are scanned from there.  Otherwise the headers are scanned from the first data packet of the section.
+/// Either way, scanning goes only as far as needed, and each data packet scanned is kept in a table with how many
+/// bytes each bytestream had before it.  So without index packets, the section's headers are only ever scanned once.
 class SeekIndex {
 public:
-    ///!!! implement seek
+                SeekIndex();
+    void        open(CheckedFile* file, PacketReadCache* cache, uint64_t indexLogicalOffset,
+                     uint64_t dataLogicalOffset, uint64_t sectionEndLogicalOffset);
+
+    /// Set up the table for the chunk holding recordNumber, and return the chunk's first record number.
+    /// Bytestream byte offsets given to locate() are relative to the start of this chunk.
+    uint64_t    startChunk(uint64_t recordNumber);
+
+    /// Find the data packet holding byte byteOffset of a bytestream, and where in the packet's buffer for the bytestream it is.
+    /// Returns false if the bytestream ends before byteOffset.
+    bool        locate(unsigned bytestreamNumber, uint64_t byteOffset, uint64_t& packetLogicalOffset,
+                       size_t& bufferIndex, size_t& bufferLength);
+
+    /// First data packet of the current chunk
+    uint64_t    chunkLogicalOffset()    {return(chunkLogicalOffset_);};
+
 #ifdef E57_DEBUG
-    void        dump(int /*indent*/ = 0, std::ostream& /*os*/ = std::cout) {/*???*/};
+    void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
+
+protected: //=================
+    void        resetTable(uint64_t chunkRecordNumber, uint64_t chunkLogicalOffset);
+    bool        scanPacket();
+
+    CheckedFile*            file_;
+    PacketReadCache*        cache_;
+    uint64_t                indexLogicalOffset_;        /// top level index packet, 0 if section has none
+    uint64_t                dataLogicalOffset_;
+    uint64_t                sectionEndLogicalOffset_;
+
+    uint64_t                chunkRecordNumber_;
+    uint64_t                chunkLogicalOffset_;        /// E57_UINT64_MAX if table not started
+    uint64_t                scanLogicalOffset_;         /// next packet to scan, E57_UINT64_MAX if reached section end
+    unsigned                bytestreamCount_;
+    std::vector<uint64_t>   packetLogicalOffsets_;      /// data packets scanned so far, in file order
+    std::vector<uint64_t>   bytestreamStarts_;          /// per packet, bytestreamCount_ byte counts of each bytestream before it
+    std::vector<uint64_t>   bytestreamEnds_;            /// byte counts of each bytestream after last packet scanned
+    std::vector<uint16_t>   bufferLengths_;             /// scratch for reading packet headers
 };
 
 //================================================================
@@ -940,6 +1117,55 @@ struct DecodeChannel {
 
 //================================================================
 
+/// Runs a set of independent tasks on a fixed group of threads.
+/// The calling thread joins in, and run() returns when every task has finished.
+/// If any task throws, the first exception is rethrown by run() (after all tasks are done).
+class WorkerPool {
+public:
+    explicit    WorkerPool(unsigned threadCount);
+                ~WorkerPool();
+    unsigned    threadCount()   {return(static_cast<unsigned>(threads_.size()) + 1);}
+    void        run(unsigned taskCount, const std::function<void (unsigned)>& task);
+
+protected: //=================
+    void        workerMain();
+    void        runTasks(std::unique_lock<std::mutex>& lock);
+
+    //??? no default ctor, copy, assignment?
+
+    std::vector<std::thread>    threads_;
+    std::mutex                  mutex_;
+    std::condition_variable     wakeWorkers_;
+    std::condition_variable     tasksDone_;
+    const std::function<void (unsigned)>* task_;
+    unsigned                    taskCount_;
+    unsigned                    nextTask_;
+    unsigned                    doneCount_;
+    unsigned                    generation_;    /// incremented for each run(), so workers can tell new work from old
+    bool                        shutdown_;
+    std::exception_ptr          error_;
+};
+
+//================================================================
+
+/// Admits jobs while the sum of their memory estimates fits in a limit.
+/// A job is always admitted when no others hold memory, so one bigger than the whole limit can't wait forever.
+class MemoryBudget {
+public:
+    explicit    MemoryBudget(uint64_t limit);
+    void        acquire(uint64_t bytes);
+    void        release(uint64_t bytes);
+
+protected: //=================
+    uint64_t                    limit_;
+    uint64_t                    used_;
+    unsigned                    holders_;
+    std::mutex                  mutex_;
+    std::condition_variable     released_;
+};
+
+//================================================================
+
 class PacketReadCache;
 
 class CompressedVectorReaderImpl {
@@ -952,6 +1178,10 @@ public:
     bool        isOpen();
     boost::shared_ptr<CompressedVectorNodeImpl> compressedVectorNode();
     void        close();
+    void        cacheStatistics(uint64_t& hits, uint64_t& misses, uint64_t& rereads);
+
+    /// In parallel mode, read() fetches up to this many data packets at a time, which each decoder then eats independently
+    static const unsigned batchPacketCount = 8;
 
 #ifdef E57_DEBUG
     void        dump(int indent = 0, std::ostream& os = std::cout);
@@ -967,6 +1197,8 @@ protected: //=================
     uint64_t    earliestPacketNeededForInput();
     void        feedPacketToDecoders(uint64_t currentPacketLogicalOffset);
     uint64_t    findNextDataPacket(uint64_t nextPacketLogicalOffset);
+    void        readBatch(uint64_t firstPacketLogicalOffset);
+    void        feedBatchToDecoder(DecodeChannel* chan);
 
     //??? no default ctor, copy, assignment?
 
@@ -976,6 +1208,15 @@ protected: //=================
     boost::shared_ptr<NodeImpl>                 proto_;
     std::vector<DecodeChannel>                  channels_;
     PacketReadCache*                            cache_;
+    WorkerPool*                                 pool_;              /// NULL if decoding serially
+
+    /// Parallel mode: copies of the current batch of data packets, shared read-only by the decoding threads
+    std::vector<char>                           batchBuffer_;
+    std::vector<uint64_t>                       batchLogicalOffsets_;
+    uint64_t                                    batchNextLogicalOffset_;  /// next data packet after batch, E57_UINT64_MAX if none
+    std::vector<DecodeChannel*>                 hungry_;            /// channels fed the current batch, reserved so read() doesn't allocate
+
+    SeekIndex                                   seekIndex_;
 
     uint64_t    recordCount_;                   /// number of records written so far
     uint64_t    maxRecordCount_;
@@ -990,6 +1231,8 @@ public:
                 ~CompressedVectorWriterImpl();
     void        write(const size_t requestedRecordCount);
     void        write(std::vector<SourceDestBuffer>& sbufs, const size_t requestedRecordCount);
+    void        writeAsync(std::vector<SourceDestBuffer>& sbufs, const size_t requestedRecordCount);
+    void        waitForWrite();
     bool        isOpen();
     boost::shared_ptr<CompressedVectorNodeImpl> compressedVectorNode();
     void        close();
@@ -1005,9 +1248,20 @@ protected: //=================
     void        checkImageFileOpen(const char* srcFileName, int srcLineNumber, const char* srcFunctionName);
     void        checkWriterOpen(const char* srcFileName, int srcLineNumber, const char* srcFunctionName);
     void        setBuffers(std::vector<SourceDestBuffer>& sbufs); //???needed?
+    void        writeRecords(const size_t requestedRecordCount);
+    void        writeSerially(uint64_t endRecordIndex);
+    void        startChunk();
+    uint64_t    writeIndexPackets();
+    void        writeThreadMain();
+    void        stopWriteThread();
+    void        writeConcurrently(uint64_t endRecordIndex);
+    void        stageOutput(unsigned bytestreamNumber);
+    size_t      bytestreamOutputAvailable(unsigned bytestreamNumber);
+    void        bytestreamOutputRead(unsigned bytestreamNumber, char* dest, size_t byteCount);
     size_t      totalOutputAvailable();
     size_t      currentPacketSize();
     uint64_t    packetWrite();
+    uint64_t    packetWrite(const std::vector<size_t>& available);
     void        flush();
 
     //??? no default ctor, copy, assignment?
@@ -1017,9 +1271,42 @@ protected: //=================
     boost::shared_ptr<NodeImpl>                 proto_;
 
     std::vector<boost::shared_ptr<Encoder> >  bytestreams_;
-    SeekIndex               seekIndex_;
     DataPacket              dataPacket_;
 
+    /// Index chunks, see startChunk()
+    uint64_t                chunkRecordCount_;              /// records per chunk, 0 if writing no index packets
+    uint64_t                chunkStartRecordIndex_;         /// first record of current chunk
+    uint64_t                chunkEndRecordIndex_;           /// first record of next chunk, E57_UINT64_MAX if no index
+    bool                    chunkStartPending_;             /// next data packet written is first of current chunk
+    std::vector<uint64_t>   chunkRecordNumbers_;            /// first record of each chunk written
+    std::vector<uint64_t>   chunkPhysicalOffsets_;          /// first data packet of each chunk written
+
+    /// Bytestream of each of sbufs_, found by ctor, so that setBuffers() doesn't look the paths up again
+    std::vector<unsigned>   sbufBytestreams_;
+    std::vector<SourceDestBuffer> sourceScratch_;           /// setBuffers() scratch, the single buffer given an Encoder
+
+    /// Scratch for packetWrite(), sized to bytestreams_ by ctor
+    std::vector<size_t>     packetAvailable_;
+    std::vector<size_t>     packetCount_;                   /// bytes the last packet took from each bytestream
+
+    /// When encoding in parallel (see writeConcurrently), each bytestream's output is moved out of its Encoder into
+    /// stagedOutput_ as it is produced, and packets take it from there first.  Empty when encoding serially.
+    std::vector<std::vector<char> > stagedOutput_;
+    std::vector<size_t>     stagedFirst_;                   /// next byte of stagedOutput_ to go in a packet
+    std::vector<size_t>     stepAvailable_;                 /// writeConcurrently() scratch, output of each bytestream after each step
+    std::vector<size_t>     stepTaken_;                     /// writeConcurrently() scratch, output of each bytestream taken by packets
+    WorkerPool*             pool_;                          /// NULL if encoding serially
+
+    /// writeAsync() hands writes to writeThread_, started on first use.  At most one write is pending at a time.
+    std::thread             writeThread_;
+    std::mutex              writeMutex_;
+    std::condition_variable writeRequested_;
+    std::condition_variable writeDone_;
+    size_t                  asyncRecordCount_;              /// record count of the pending write
+    bool                    asyncPending_;                  /// a write has been handed to writeThread_ and hasn't finished
+    bool                    writeThreadShutdown_;
+    std::exception_ptr      asyncError_;                    /// what the last write on writeThread_ threw, until waitForWrite() rethrows it
+
     bool                    isOpen_;
     uint64_t                sectionHeaderLogicalStart_;     /// start of CompressedVector binary section
     uint64_t                sectionLogicalLength_;          /// total length of CompressedVector binary section
@@ -1209,6 +1496,10 @@ public:
     virtual uint64_t    totalRecordsCompleted() = 0;
     virtual size_t      inputProcess(const char* source, const size_t count) = 0;
     virtual void        stateReset() = 0;
+
+    /// Drop any queued input and restart output at record recordIndex, given that the bytestream data fed next
+    /// starts at record chunkRecordIndex.  Returns the byte offset in that data to feed from, or E57_UINT64_MAX if no input is needed.
+    virtual uint64_t    seekRecord(uint64_t recordIndex, uint64_t chunkRecordIndex) = 0;
     unsigned            bytestreamNumber() {return(bytestreamNumber_);};
 #ifdef E57_DEBUG
     virtual void        dump(int indent = 0, std::ostream& os = std::cout) = 0;
@@ -1235,6 +1526,7 @@ public:
     virtual size_t      inputProcessAligned(const char* inbuf, const size_t firstBit, const size_t endBit) = 0;
 
     virtual void        stateReset();
+    virtual uint64_t    seekRecord(uint64_t recordIndex, uint64_t chunkRecordIndex);
 
 #ifdef E57_DEBUG
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
@@ -1244,6 +1536,12 @@ protected: //================
 
     void                inBufferShiftDown();
 
+    /// Bits each record takes in the bytestream, 0 if records vary in length (and so can't be seeked to)
+    virtual unsigned    recordBitCount() = 0;
+
+    /// Zeroed bytes past the usable end of inBuffer_, so subclasses can load whole words (or 8 bytes) at the last record without running off the end
+    static const size_t inBufferGuardSize = 8;
+
     uint64_t            currentRecordIndex_;
     uint64_t            maxRecordCount_;
 
@@ -1269,6 +1567,8 @@ public:
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
 protected: //================
+    virtual unsigned    recordBitCount() {return((precision_ == E57_SINGLE) ? 8*sizeof(float) : 8*sizeof(double));};
+
     FloatPrecision      precision_;
 };
 
@@ -1284,6 +1584,8 @@ public:
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
 protected: //================
+    virtual unsigned    recordBitCount() {return(0);};
+
     bool        readingPrefix_;
     int         prefixLength_;
     uint8_t     prefixBytes_[8];
@@ -1301,12 +1603,16 @@ public:
                         BitpackIntegerDecoder(bool isScaledInteger, unsigned bytestreamNumber, SourceDestBuffer& dbuf,
                                               int64_t minimum, int64_t maximum, double scale, double offset, uint64_t maxRecordCount);
 
+    virtual void        destBufferSetNew(std::vector<SourceDestBuffer>& dbufs);
     virtual size_t      inputProcessAligned(const char* inbuf, const size_t firstBit, const size_t endBit);
 
 #ifdef E57_DEBUG
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
 protected: //================
+    virtual unsigned    recordBitCount() {return(bitsPerRecord_);};
+    void                selectArrayStore();
+
     bool        isScaledInteger_;
     int64_t     minimum_;
     int64_t     maximum_;
@@ -1314,6 +1620,12 @@ protected: //================
     double      offset_;
     unsigned    bitsPerRecord_;
     RegisterT   destBitMask_;
+
+    /// Specialized store of unpacked values for destBuffer_, NULL if they must go through setNextInt64Array()
+    SourceDestBufferImpl::Int64ArrayStore arrayStore_;
+
+    /// Records unpacked per call of the bit unpacking kernel
+    static const size_t unpackLaneCount = 256;
 };
 
 //================================================================
@@ -1326,6 +1638,7 @@ public:
     virtual uint64_t    totalRecordsCompleted() {return(currentRecordIndex_);};
     virtual size_t      inputProcess(const char* source, const size_t byteCount);
     virtual void        stateReset();
+    virtual uint64_t    seekRecord(uint64_t recordIndex, uint64_t chunkRecordIndex);
 #ifdef E57_DEBUG
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
@@ -1343,8 +1656,63 @@ protected: //================
 
 //================================================================
 
+/// Reads the packets of a binary section ahead of use, on a background thread.
+/// The thread has its own CheckedFile (and file descriptor), so file reads and checksum verification
+/// overlap with decoding, without sharing any file state with the foreground.
+/// Packets are read in file order, so it follows the same chain as CompressedVectorReaderImpl::findNextDataPacket.
+class PacketPrefetcher {
+public:
+                PacketPrefetcher(const ustring& fileName, const CheckedFile::Options& options, unsigned packetCount,
+                                 uint64_t firstPacketLogicalOffset, uint64_t sectionEndLogicalOffset);
+                ~PacketPrefetcher();
+
+    /// If packet has been (or is about to be) prefetched, swap it into buffer and return true.
+    /// Returns false if caller must read the packet itself.
+    bool        take(uint64_t packetLogicalOffset, char* &buffer);
+
+    /// Pages read and verified by the thread since the last call, so caller can add them to its file statistics.
+    void        takePageCounts(uint64_t& pagesRead, uint64_t& pagesChecked);
+
+    /// Drop everything read ahead, and start again from packetLogicalOffset (after a seek).
+    void        restart(uint64_t packetLogicalOffset);
+
+protected: //=================
+    void        stopThread();
+    void        threadMain();
+    void        recycleFront();
+
+    //??? no default ctor, copy, assignment?
+
+    struct Slot {
+        uint64_t    logicalOffset;
+        char*       buffer;
+    };
+
+    CheckedFile*            file_;
+    uint64_t                sectionEndLogicalOffset_;
+    std::vector<char*>      free_;              /// buffers available to read into
+    std::vector<Slot>       ready_;             /// packets read, in file order.  Few, so erasing front is cheap, and reserved so never allocates
+    uint64_t                nextLogicalOffset_; /// next packet the thread will read
+    uint64_t                readingLogicalOffset_;  /// packet thread is reading now, E57_UINT64_MAX if none
+    uint64_t                errorLogicalOffset_;    /// packet thread failed on, E57_UINT64_MAX if none
+    unsigned                generation_;        /// incremented when restarted at a new position
+    bool                    shutdown_;
+    uint64_t                pagesRead_;         /// file_ page counts, updated by thread after each packet
+    uint64_t                pagesChecked_;
+    uint64_t                pagesReadTaken_;    /// counts already passed on by takePageCounts()
+    uint64_t                pagesCheckedTaken_;
+    std::mutex              mutex_;
+    std::condition_variable wakeThread_;
+    std::condition_variable packetReady_;
+    std::thread             thread_;
+};
+
+//================================================================
+
 class PacketLock {
 public:
+    /// Returned by value from PacketReadCache::lock(), so it lives on the caller's stack.  Moved from lock unlocks nothing.
+                    PacketLock(PacketLock&& plock);
                     ~PacketLock();
 
 private: //================
@@ -1357,7 +1725,7 @@ protected: //================
     /// Only PacketReadCache can construct
                      PacketLock(PacketReadCache* cache, unsigned cacheIndex);
 
-    PacketReadCache* cache_;
+    PacketReadCache* cache_;            /// NULL if moved from
     unsigned         cacheIndex_;
 };
 
@@ -1368,8 +1736,17 @@ public:
                         PacketReadCache(CheckedFile* cFile, unsigned packetCount);
                         ~PacketReadCache();
 
-    std::auto_ptr<PacketLock> lock(uint64_t packetLogicalOffset, char* &pkt);  //??? pkt could be const
+    PacketLock           lock(uint64_t packetLogicalOffset, char* &pkt);  //??? pkt could be const
     void                 markDiscarable(uint64_t packetLogicalOffset);
+    void                 startPrefetch(const ustring& fileName, const CheckedFile::Options& options, unsigned packetCount,
+                                       uint64_t firstPacketLogicalOffset, uint64_t sectionEndLogicalOffset);
+    void                 restartPrefetch(uint64_t packetLogicalOffset);
+    void                 reset();
+    unsigned             packetCount() {return(static_cast<unsigned>(entries_.size()));};
+    static unsigned      readPacketFrom(CheckedFile* cFile, uint64_t packetLogicalOffset, char* buffer);
+
+    /// Lookups found in cache, lookups that had to read the packet, and how many of those reads were of a packet read before
+    void                 statistics(uint64_t& hits, uint64_t& misses, uint64_t& rereads);
 
 #ifdef E57_DEBUG
     void                dump(int indent = 0, std::ostream& os = std::cout);
@@ -1380,17 +1757,39 @@ protected: //================
     void                unlock(unsigned cacheIndex);
 
     void                readPacket(unsigned oldestEntry, uint64_t packetLogicalOffset);
+    void                stopPrefetch();
+    void                unlinkEntry(unsigned entry);
+    void                makeNewest(unsigned entry);
+    void                makeOldest(unsigned entry);
+    unsigned            homeSlot(uint64_t packetLogicalOffset);
+    unsigned            findEntry(uint64_t packetLogicalOffset);
+    void                setEntryOffset(unsigned entry, uint64_t packetLogicalOffset);
+    bool                notePacketRead(uint64_t packetLogicalOffset, uint64_t packetLogicalEnd);
+
+    static const unsigned noEntry = E57_UINT32_MAX;
 
     struct CacheEntry {
-        uint64_t    logicalOffset_;
+        uint64_t    logicalOffset_;     /// 0 if entry empty
         char*       buffer_;  //??? could be const?
-        unsigned    lastUsed_;
+        unsigned    lockCount_;         /// number of PacketLocks outstanding on entry
+        unsigned    newer_;             /// links in least recently used list, noEntry at ends
+        unsigned    older_;
     };
 
-    unsigned            lockCount_;
-    unsigned            useCount_;
+    unsigned            lockCount_;         /// total PacketLocks outstanding
+    unsigned            newestEntry_;
+    unsigned            oldestEntry_;
     CheckedFile*        cFile_;
     std::vector<CacheEntry>  entries_;
+    /// Neither table allocates once the cache is set up: entrySlots_ is sized by ctor, and reading
+    /// packets in file order just extends the last extent of packetsRead_ (only seeks add extents).
+    std::vector<unsigned> entrySlots_;      /// open addressing hash of entries holding a packet, by logical offset, noEntry if slot free
+    unsigned            slotBits_;          /// entrySlots_ has 2^slotBits_ slots, at least twice the entries
+    std::vector<std::pair<uint64_t, uint64_t> > packetsRead_;  /// logical extents of every packet read so far, sorted and merged
+    uint64_t            hits_;
+    uint64_t            misses_;
+    uint64_t            rereads_;
+    PacketPrefetcher*   prefetcher_;        /// NULL if not reading ahead
 };
 
 //================================================================
@@ -1224,6 +1224,18 @@ CompressedVectorReader	Reader :: SetUpData3DPointsData(
 		timeStamp, isTimeStampInvalid);
 }
 
+bool		Reader :: ReadData3DPointsDataConcurrently(
+	const std::vector<int32_t> & dataIndexes,	// data blocks to read, each at most once
+	const Data3DReaderSetUp &	setUp,		// opens the reader of one block
+	const Data3DPointsConsumer &	consume,	// receives the points of each read
+	uint64_t	bufferBytes,		// memory used by the buffers of one block
+	unsigned	threadCount,		// maximum number of blocks read at once, 0 is one per core
+	uint64_t	memoryLimit			// maximum memory of the blocks in progress, 0 is no limit
+	) const							// \return Return true if sucessful, false if a dataIndex is out of range
+{
+	return impl_->ReadData3DPointsDataConcurrently(dataIndexes, setUp, consume, bufferBytes, threadCount, memoryLimit);
+}
+
 ////////////////////////////////////////////////////////////////////
 //
 //	e57::Writer
@@ -73,6 +73,12 @@ namespace e57 {
 class ReaderImpl;
 class WriterImpl;
 
+//! @brief Called on a worker thread to open the reader of one Data3D block, normally by calling Reader::SetUpData3DPointsData with buffers owned by that block
+typedef std::function<CompressedVectorReader (int32_t dataIndex)> Data3DReaderSetUp;
+
+//! @brief Called on the same worker thread after each CompressedVectorReader::read() of the block that returns points
+typedef std::function<void (int32_t dataIndex, unsigned pointCount)> Data3DPointsConsumer;
+
 ////////////////////////////////////////////////////////////////////
 //
 //	e57::Point
@@ -726,6 +732,23 @@ Call the CompressedVectorReader::read() until all data is read.
 						int8_t*		isTimeStampInvalid = NULL	//!< Value = 0 if the timeStamp is considered valid, 1 otherwise
 						) const;					//!< @return Return true if sucessful, false otherwise
 
+//! @brief This function reads the point data of several Data3D blocks at once, each on its own thread
+/*! @details For each block, setUp is called to get its reader, then read() is called until the block is done,
+passing the number of points of each read to consume, then the reader is closed.
+Blocks are read on up to threadCount threads (0 means one per core), and a block isn't started while
+its bufferBytes plus the memory of the blocks in progress would go over memoryLimit (0 means no limit).
+setUp and consume are called on worker threads, so must only touch data of their own block.
+If setUp or consume throws, the remaining blocks are still read, then the first exception is rethrown.
+*/
+	bool		ReadData3DPointsDataConcurrently(
+						const std::vector<int32_t> & dataIndexes,	//!< data blocks to read, each at most once
+						const Data3DReaderSetUp &	setUp,		//!< opens the reader of one block
+						const Data3DPointsConsumer &	consume,	//!< receives the points of each read
+						uint64_t	bufferBytes,		//!< memory used by the buffers of one block
+						unsigned	threadCount = 0,	//!< maximum number of blocks read at once
+						uint64_t	memoryLimit = 0		//!< maximum memory of the blocks in progress
+						) const;					//!< @return Return true if sucessful, false if a dataIndex is out of range
+
 ////////////////////////////////////////////////////////////////////
 //
 //	Raw File information
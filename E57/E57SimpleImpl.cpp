@@ -1636,6 +1636,49 @@ CompressedVectorReader	ReaderImpl :: SetUpData3DPointsData(
 	return reader;
 };
 
+//! This function reads the point data of several Data3D blocks at once, each on its own thread
+bool	ReaderImpl :: ReadData3DPointsDataConcurrently(
+	const std::vector<int32_t> & dataIndexes,	//!< data blocks to read, each at most once
+	const Data3DReaderSetUp &	setUp,		//!< opens the reader of one block
+	const Data3DPointsConsumer &	consume,	//!< receives the points of each read
+	uint64_t	bufferBytes,		//!< memory used by the buffers of one block
+	unsigned	threadCount,		//!< maximum number of blocks read at once, 0 is one per core
+	uint64_t	memoryLimit			//!< maximum memory of the blocks in progress, 0 is no limit
+	)								//!< \return Return true if sucessful, false if a dataIndex is out of range
+{
+	vector<ReadTask> tasks;
+	for(size_t i = 0; i < dataIndexes.size(); i++)
+	{
+		int32_t dataIndex = dataIndexes[i];
+		if( (dataIndex < 0) || (dataIndex >= data3D_.childCount()))
+			return false;
+
+// Each block gets its own reader (and so its own packet cache), only the ImageFile is shared.
+// It reads at most every field of the prototype, which sizes the reader's packet buffers.
+		StructureNode scan(data3D_.get(dataIndex));
+		CompressedVectorNode points(scan.get("points"));
+		StructureNode proto(points.prototype());
+		unsigned channelCount = static_cast<unsigned>(proto.childCount());
+
+		tasks.push_back(ReadTask([dataIndex, &setUp, &consume]()
+		{
+			CompressedVectorReader reader = setUp(dataIndex);
+			try {
+				unsigned count;
+				while((count = reader.read()) > 0)
+					consume(dataIndex, count);
+			} catch(...) {
+				reader.close();
+				throw;
+			}
+			reader.close();
+		}, bufferBytes, channelCount));
+	}
+
+	imf_.readConcurrently(tasks, threadCount, memoryLimit);
+	return true;
+};
+
 //#define TEST_EXTENSIONS
 ////////////////////////////////////////////////////////////////////
 //
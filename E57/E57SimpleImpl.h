@@ -260,6 +260,16 @@ virtual CompressedVectorReader	SetUpData3DPointsData(
 						int8_t*		isTimeStampInvalid = NULL	//!< Value = 0 if the timeStamp is considered valid, 1 otherwise
 						);
 
+//! This function reads the point data of several Data3D blocks at once, each on its own thread
+virtual bool		ReadData3DPointsDataConcurrently(
+						const std::vector<int32_t> & dataIndexes,	//!< data blocks to read, each at most once
+						const Data3DReaderSetUp &	setUp,		//!< opens the reader of one block
+						const Data3DPointsConsumer &	consume,	//!< receives the points of each read
+						uint64_t	bufferBytes,		//!< memory used by the buffers of one block
+						unsigned	threadCount,		//!< maximum number of blocks read at once, 0 is one per core
+						uint64_t	memoryLimit			//!< maximum memory of the blocks in progress, 0 is no limit
+						);							//!< \return Return true if sucessful, false if a dataIndex is out of range
+
 //! This function returns the file raw E57Root Structure Node
 virtual	StructureNode		GetRawE57Root(void);	//!< /return Returns the E57Root StructureNode
 //! This function returns the raw Data3D Vector Node
@@ -0,0 +1,129 @@
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <unordered_map>
+#include <random>
+#include <cmath>
+#include <stdint.h>
+
+//Downsamples a scan while it is decoded: blocks are handed to add() as they come out of the reader,
+//and only what the output needs is kept, so memory follows the size of the result, never the scan's.
+//Points are first kept at random with probability keepFraction, then, if leafSize > 0, merged into
+//the centroid of their leafSize cube, as pcl::VoxelGrid does. Points with non finite coordinates are dropped,
+//and so are points too far from the origin for leafSize, whose voxel index wouldn't fit 64 bits.
+class StreamingDownsampler{
+
+	private:
+		//Integer coordinates of a voxel, 64 bits so that georeferenced coordinates and small leaves don't wrap
+		struct VoxelKey{
+			int64_t x, y, z;
+			bool operator==(const VoxelKey &other) const { return x == other.x && y == other.y && z == other.z; }
+		};
+		struct VoxelKeyHash{
+			size_t operator()(const VoxelKey &key) const {
+				/// Large primes of the spatial hash of Teschner et al., enough to spread neighbouring voxels.
+				/// All 64 bits of each index go in, so voxels far apart don't share a hash.
+				uint64_t hash = (uint64_t)key.x * 73856093ULL ^ (uint64_t)key.y * 19349663ULL ^ (uint64_t)key.z * 83492791ULL;
+				return (size_t)(hash ^ (hash >> 32));
+			}
+		};
+		//Sums of the points of a voxel, in double so that millions of points don't lose the centroid
+		struct VoxelSum{
+			double x, y, z, intensity;
+			uint64_t count;
+			VoxelSum() : x(0), y(0), z(0), intensity(0), count(0) {}
+		};
+
+		float leafSize_;
+		double keepFraction_;
+		std::minstd_rand random_;
+		std::uniform_real_distribution<double> uniform_;
+		std::unordered_map<VoxelKey, VoxelSum, VoxelKeyHash> voxels_;
+		pcl::PointCloud<pcl::PointXYZI> kept_;	//points kept by sampling alone, when there is no voxel grid
+		uint64_t seen_;
+		uint64_t outOfRange_;	//points dropped because their voxel index would overflow
+
+		//Voxel index of coordinate, false if it doesn't fit an int64_t
+		static inline bool voxelIndex(float coordinate, double inverseLeaf, int64_t &index){
+			/// 2^63, the first double past INT64_MAX
+			const double indexLimit = 9223372036854775808.0;
+			double cell = std::floor(coordinate * inverseLeaf);
+			if(!(cell >= -indexLimit && cell < indexLimit))
+				return false;
+			index = (int64_t)cell;
+			return true;
+		}
+
+	public:
+		//leafSize 0 is no voxel grid, keepFraction 1 keeps every point. seed makes the sampling repeatable.
+		StreamingDownsampler(float leafSize, double keepFraction = 1, unsigned seed = 5489u)
+			: leafSize_(leafSize), keepFraction_(keepFraction), random_(seed), uniform_(0, 1), seen_(0), outOfRange_(0) {}
+
+		inline bool isVoxelGrid() const { return leafSize_ > 0; }
+		inline uint64_t pointsSeen() const { return seen_; }
+		//Points dropped so far because leafSize is too small for how far they are from the origin
+		inline uint64_t pointsOutOfRange() const { return outOfRange_; }
+
+		//Takes the points of one decoded block; block can be reused by the caller right after
+		inline void add(const pcl::PointCloud<pcl::PointXYZI> &block){
+			const double inverseLeaf = leafSize_ > 0 ? 1.0 / leafSize_ : 0;
+			const bool sample = keepFraction_ < 1;
+			seen_ += block.points.size();
+			for(size_t j = 0; j < block.points.size(); j++){
+				const pcl::PointXYZI &point = block.points[j];
+				if(!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+					continue;
+				if(sample && uniform_(random_) >= keepFraction_)
+					continue;
+				if(leafSize_ <= 0){
+					kept_.points.push_back(point);
+					continue;
+				}
+				VoxelKey key;
+				if(!voxelIndex(point.x, inverseLeaf, key.x) || !voxelIndex(point.y, inverseLeaf, key.y) || !voxelIndex(point.z, inverseLeaf, key.z)){
+					outOfRange_++;
+					continue;
+				}
+				VoxelSum &sum = voxels_[key];
+				sum.x += point.x;
+				sum.y += point.y;
+				sum.z += point.z;
+				sum.intensity += point.intensity;
+				sum.count++;
+			}
+		}
+
+		//Number of points the output will have so far
+		inline size_t size() const { return leafSize_ > 0 ? voxels_.size() : kept_.points.size(); }
+
+		//Writes the downsampled points to out, and starts over
+		inline void finish(pcl::PointCloud<pcl::PointXYZI> &out){
+			if(leafSize_ > 0){
+				out.points.clear();
+				out.points.reserve(voxels_.size());
+				for(auto it = voxels_.begin(); it != voxels_.end(); ++it){
+					const VoxelSum &sum = it->second;
+					pcl::PointXYZI point;
+					point.x = (float)(sum.x / sum.count);
+					point.y = (float)(sum.y / sum.count);
+					point.z = (float)(sum.z / sum.count);
+					point.intensity = (float)(sum.intensity / sum.count);
+					out.points.push_back(point);
+				}
+				std::unordered_map<VoxelKey, VoxelSum, VoxelKeyHash>().swap(voxels_);
+			}
+			else {
+				out.points.swap(kept_.points);
+				kept_.points.clear();
+			}
+			out.width = out.points.size();
+			out.height = 1;
+			out.is_dense = true;
+			seen_ = 0;
+			outOfRange_ = 0;
+		}
+};
+
+#endif
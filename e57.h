@@ -11,7 +11,13 @@
 #include <pcl/point_types.h>
 #include <iostream>
 #include <ctime>
+#include <cmath>
+#include <cfloat>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
 //Contains the structure of XYZ point data
 #include "E57/E57Foundation.h"  //libE57 API
 #include "E57/E57Simple.h"
@@ -80,142 +86,239 @@ class E57{
             }
 		}
 
+        //Scale that brings coordinates of a scan whose widest axis spans span to meters. E57 coordinates are meters,
+        //but some writers store millimeters or centimeters, which no terrestrial scan spans that far in meters.
+        //It is the span (max - min) and not the largest magnitude, so georeferenced scans far from the origin stay in meters.
+        //Aerial and mobile mapping scans in meters can span more than 1 km, so this is only a guess, made on request.
+        static inline float unitScaleFor(double span){
+            if(span > 10000)
+                return 0.001f;
+            if(span > 1000)
+                return 0.01f;
+            return 1;
+        }
+
+        //Unit scale the prototype of a scan's points says its xyz are in, 0 if it doesn't say.
+        //ScaledInteger xyz are written in meters to the resolution of their scale (e.g. 0.001 for millimeters), and the
+        //reader applies the scale, so they come out in meters. Float xyz carry no such metadata.
+        static inline float prototypeUnitScale(StructureNode &proto){
+            const char *names[3] = {"cartesianX", "cartesianY", "cartesianZ"};
+            for(int i = 0; i < 3; i++)
+                if(!proto.isDefined(names[i]) || proto.get(names[i]).type() != E57_SCALED_INTEGER)
+                    return 0;
+            return 1;
+        }
+
+        //Unit scale from the cartesianBounds of scan, 0 if the scan has no usable bounds
+        //(writers that don't know the bounds leave them at +-E57_DOUBLE_MAX)
+        static inline float boundsUnitScale(StructureNode &scan){
+            if(!scan.isDefined("cartesianBounds"))
+                return 0;
+            StructureNode bounds(scan.get("cartesianBounds"));
+            const char *names[6] = {"xMinimum", "xMaximum", "yMinimum", "yMaximum", "zMinimum", "zMaximum"};
+            double value[6];
+            for(int i = 0; i < 6; i++){
+                if(!bounds.isDefined(names[i]) || bounds.get(names[i]).type() != E57_FLOAT)
+                    return 0;
+                value[i] = FloatNode(bounds.get(names[i])).value();
+                if(!(std::fabs(value[i]) < E57_DOUBLE_MAX))
+                    return 0;
+            }
+            double span = 0;
+            for(int axis = 0; axis < 3; axis++)
+                span = std::max(span, value[2*axis+1] - value[2*axis]);
+            return unitScaleFor(span);
+        }
+
+        //Unit scale from a sample of at most sampleSize of the count points starting at first
+        static inline float sampledUnitScale(const P_XYZ *first, size_t count, size_t sampleSize = 4096){
+            size_t step = std::max<size_t>(count / sampleSize, 1);
+            float minimum[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+            float maximum[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+            for(size_t j = 0; j < count; j += step){
+                const float coordinate[3] = {first[j].x, first[j].y, first[j].z};
+                for(int axis = 0; axis < 3; axis++){
+                    /// NaNs of invalid points never win the comparisons inside std::min/std::max
+                    minimum[axis] = std::min(minimum[axis], coordinate[axis]);
+                    maximum[axis] = std::max(maximum[axis], coordinate[axis]);
+                }
+            }
+            double span = 0;
+            for(int axis = 0; axis < 3; axis++)
+                if(minimum[axis] <= maximum[axis])
+                    span = std::max(span, (double)maximum[axis] - minimum[axis]);
+            return unitScaleFor(span);
+        }
+
+        //Moves count points by placement in place, the way pcl::transformPointCloud does, without a second cloud.
+        //The coefficients are kept in locals, so the loop has no branches and nothing it writes can alias them.
+        static inline void placePoints(P_XYZ *first, size_t count, const Eigen::Matrix4f &placement){
+            const float m00 = placement(0,0), m01 = placement(0,1), m02 = placement(0,2), m03 = placement(0,3);
+            const float m10 = placement(1,0), m11 = placement(1,1), m12 = placement(1,2), m13 = placement(1,3);
+            const float m20 = placement(2,0), m21 = placement(2,1), m22 = placement(2,2), m23 = placement(2,3);
+            for(size_t j = 0; j < count; j++){
+                P_XYZ &point = first[j];
+                const float x = point.x, y = point.y, z = point.z;
+                point.x = m00 * x + m01 * y + m02 * z + m03;
+                point.y = m10 * x + m11 * y + m12 * z + m13;
+                point.z = m20 * x + m21 * y + m22 * z + m23;
+            }
+        }
+
 	public:
-        E57(){}
-        ~E57(){}
-        inline int openE57(const std::string &filename, PtrXYZ &pointcloud, float &scale_factor, int64_t& scanCount, Eigen::Matrix4f& mat4, int64_t scanIndex = 0){
-			try{
-				ImageFile imf(filename, "r");
-			    StructureNode root = imf.root();
-				/// Make sure vector of scans is defined and of expected type.
-				/// If "/data3D" wasn't defined, the call to root.get below would raise an exception.
-				if (!root.isDefined("/data3D")) {
-					cout << "File doesn't contain 3D images."<<endl;
-					return 0;
-				}
-				Node n = root.get("/data3D");
-				if (n.type() != E57_VECTOR) {
-					cout <<"File Corrupted. Error during opening."<<endl;
-					return 0;
-				}
-				
-				/// The node is a vector so we can safely get a VectorNode handle to it.
-				/// If n was not a VectorNode, this would raise an exception.
-				VectorNode data3D(n);
-			
-				/// Print number of children of data3D.  This is the number of scans in file.
-				scanCount = data3D.childCount();
-				//~ 
-				
-				if(scanCount == 0 || scanIndex < 0 || scanIndex >= scanCount){
-					cout <<"File doesn't contain valid informations."<<endl;
-					return 0;
-				}
-				
-				/// Get scan from "/data3D", assume its a Structure (else get exception)
-				StructureNode scan(data3D.get(scanIndex));
-				std::cout << scan.elementName() << std::endl;
+        //Number of records decoded per CompressedVectorReader::read() call in streaming mode
+        static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
 
-				StructureNode pose(scan.get("pose"));
-				StructureNode rotation(pose.get("rotation"));
-				StructureNode translation(pose.get("translation"));
-				float rx = FloatNode(rotation.get("x")).value();
-				float ry = FloatNode(rotation.get("y")).value();
-				float rz = FloatNode(rotation.get("z")).value();
-				float rw = FloatNode(rotation.get("w")).value();
-				float tx = FloatNode(translation.get("x")).value();
-				float ty = FloatNode(translation.get("y")).value();
-				float tz = FloatNode(translation.get("z")).value();
-				std::cout << tx << " " << ty << " " << tz << " " << rx << " " << ry << " " << rz << " " << rw << std::endl;
+        //Receives each decoded block of points; totalPoints is the record count of the whole scan
+        typedef std::function<void(const pcl::PointCloud<P_XYZ> &block, int64_t totalPoints)> BlockCallback;
 
-				Eigen::Matrix3f mat3 = Eigen::Quaternionf(rw, rx, ry, rz).toRotationMatrix();
-				mat4 = Eigen::Matrix4f::Identity();
-				mat4.block(0,0,3,3) = mat3;
-				mat4.block(0,3,3,1) = Eigen::Vector3f(tx, ty, tz);
+        //Same as BlockCallback, for readers of several scans at once; scanIndex tells which scan the block is from
+        typedef std::function<void(int64_t scanIndex, const pcl::PointCloud<P_XYZ> &block, int64_t totalPoints)> ScanBlockCallback;
 
-				/// Get "points" field in scan.  Should be a CompressedVectorNode.
-				CompressedVectorNode points(scan.get("points"));
-				
-				cout<<"Points: "<<points.childCount()<<endl;
-				pointcloud->width = points.childCount();
-				pointcloud->height = 1;
-				pointcloud->is_dense = false;
-				pointcloud->resize(pointcloud->width * pointcloud->height);
-				/// Call subroutine in this file to print the points
-				StructureNode proto(points.prototype());
-			    /// The prototype should have a field named either "cartesianX" or "sphericalRange".
-                if (proto.isDefined("cartesianX") && proto.isDefined("cartesianY") && proto.isDefined("cartesianZ")) {
-			        /// Make a list of buffers to receive the xyz values.
-			        vector<SourceDestBuffer> destBuffers;
-					float *x = new float[points.childCount()];
-					float *y = new float[points.childCount()];
-                    float *z = new float[points.childCount()];
-                    destBuffers.push_back(SourceDestBuffer(imf, "cartesianX", x, points.childCount(), true));
-			        destBuffers.push_back(SourceDestBuffer(imf, "cartesianY", y, points.childCount(), true));
-			        destBuffers.push_back(SourceDestBuffer(imf, "cartesianZ", z, points.childCount(), true));
-                    //destBuffers.push_back(SourceDestBuffer(imf, "intensity", intensity, points.childCount(), true));
-			        /// Create a reader of the points CompressedVector, try to read first block of N points
-			        /// Each call to reader.read() will fill the xyz buffers until the points are exhausted.
-                    CompressedVectorReader reader = points.reader(destBuffers);
-                    if(reader.read() <= 0)
-                    {
-                        cout << "Failed to read E57 file" << endl;
-                        return -1;
-                    }
-			        float min_scale = 100;	//assigned an high value before starting.
-                    auto j = 0;
-                    for(auto &point:pointcloud->points){
-						
-                        point.x = x[j];	//seems E57 is expressed in millimeters
-                        point.y = y[j];	//seems E57 is expressed in millimeters
-                        point.z = z[j];	//seems E57 is expressed in millimeters
-						
-                        if(point.x > 10000 || point.y > 10000 || point.z > 10000)
-                        {
-                            point.x = point.x  * 0.001;
-                            point.y = point.y  * 0.001;
-                            point.z = point.z  * 0.001;
-                            if(min_scale > 0.001)
-                                min_scale = 0.001;
-						}
-                        if(point.x > 1000 || point.y > 1000 || point.z > 1000){
-                            point.x = point.x  * 0.01;
-                            point.y = point.y  * 0.01;
-                            point.z = point.z  * 0.01;
-							if(min_scale > 0.01)
-								min_scale = 0.01;
-						}
-                        else if(point.x > 100 || point.y > 100 || point.z > 100){
-                            point.x = point.x  * 0.1;
-                            point.y = point.y  * 0.1;
-                            point.z = point.z  * 0.1;
-							if(min_scale > 0.1)
-								min_scale = 0.1;
-						}
-                        else if(point.x > 10 || point.y > 10 || point.z > 10){
-                            point.x = point.x  * 1.0;
-                            point.y = point.y  * 1.0;
-                            point.z = point.z  * 1.0;
-							if(min_scale > 1.0)
-								min_scale = 1.0;
-						}
-                        j++;
-					}
-					scale_factor = min_scale;
-					reader.close();
-                    imf.close();
-					return 1;
-				}
-				else {
-					cout<<"Error during reading file."<<endl;
-				
-					return 0;
-				}
-				
-			} catch(E57Exception& ex){
+        //Outcome of one scan of streamScans/readScans, same meaning as the return value and outputs of readScan
+        struct ScanResult{
+            int result;
+            float scale_factor;
+            Eigen::Matrix4f mat4;
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+        typedef std::vector<ScanResult, Eigen::aligned_allocator<ScanResult> > ScanResults;
+
+        //What is done to the points in the decoding pass, while they are still in cache
+        struct DecodeOptions{
+            //Move the points by the scan pose, so they come out in the file's coordinate system.
+            //mat4 still reports the pose, it must not be applied again.
+            bool applyPose;
+            //xyz are scaled from ScaledInteger to their real values by the reader and then multiplied by
+            //unitScale (e.g. 0.001 for millimeters), which becomes scale_factor. 0 takes the unit once per scan
+            //from its prototype (see prototypeUnitScale), and else uses meters as the E57 standard says.
+            float unitScale;
+            //When unitScale is 0 and the prototype doesn't tell the unit, guess it from the span of the scan's
+            //cartesianBounds or else of a sample of the first block (see unitScaleFor), instead of using meters.
+            bool guessUnit;
+
+            DecodeOptions(bool applyPose = false, float unitScale = 0, bool guessUnit = false) : applyPose(applyPose), unitScale(unitScale), guessUnit(guessUnit) {}
+        };
+
+        E57() : sessionScanCount_(0) {}
+        ~E57(){ closeSession(); }
+
+        //Loads a whole scan into pointcloud. Points are decoded straight into the cloud memory,
+        //so nothing but the output cloud is sized to the scan (blockSize only matters when streaming).
+        inline int openE57(const std::string &filename, PtrXYZ &pointcloud, float &scale_factor, int64_t& scanCount, Eigen::Matrix4f& mat4, int64_t scanIndex = 0, size_t blockSize = DEFAULT_BLOCK_SIZE, const DecodeOptions &options = DecodeOptions()){
+            pointcloud->clear();
+            int result = decodeFile(filename, BlockCallback(), pointcloud.get(), scale_factor, scanCount, mat4, scanIndex, blockSize, options);
+            finishCloud(pointcloud);
+            return result;
+        }
+
+        //Decodes a scan in fixed-size blocks and hands every block to onBlock, so peak memory
+        //is bounded by blockSize rather than by the number of points in the scan.
+        //Opens and parses the whole file for this one scan; use a session to read several scans.
+        inline int streamE57(const std::string &filename, const BlockCallback &onBlock, float &scale_factor, int64_t& scanCount, Eigen::Matrix4f& mat4, int64_t scanIndex = 0, size_t blockSize = DEFAULT_BLOCK_SIZE, const DecodeOptions &options = DecodeOptions()){
+            return decodeFile(filename, onBlock, NULL, scale_factor, scanCount, mat4, scanIndex, blockSize, options);
+        }
+
+        //Opens filename and keeps it open for a session of scan reads, so the header and XML section
+        //are parsed once, and the file handle and packet caches are reused from scan to scan.
+        //Closes any session already open. Returns the number of scans, or -1 if the file can't be opened.
+        inline int64_t openSession(const std::string &filename, const std::string &configuration = ""){
+            closeSession();
+            try{
+                session_ = std::make_shared<ImageFile>(filename, "r", configuration);
+                sessionScanCount_ = std::max<int64_t>(countScans(*session_), 0);
+                return sessionScanCount_;
+            } catch(E57Exception& ex){
+                cout << "Error opening file: " << ex.what() << endl;
+                session_.reset();
+                return -1;
+            }
+        }
+
+        inline void closeSession(){
+            if(session_){
+                try{
+                    session_->close();
+                } catch(E57Exception& ex){
+                    cout << "Error closing file: " << ex.what() << endl;
+                }
+                session_.reset();
+            }
+            sessionScanCount_ = 0;
+        }
+
+        inline bool isSessionOpen() const { return (bool)session_; }
+        inline int64_t sessionScanCount() const { return sessionScanCount_; }
+
+        //Number of points in scan scanIndex of the open session, -1 if there is no such scan
+        inline int64_t sessionScanPoints(int64_t scanIndex){
+            if(!session_ || scanIndex < 0 || scanIndex >= sessionScanCount_)
+                return -1;
+            try{
+                VectorNode data3D(session_->root().get("/data3D"));
+                StructureNode scan(data3D.get(scanIndex));
+                return CompressedVectorNode(scan.get("points")).childCount();
+            } catch(E57Exception& ex){
                 cout << "Error during reading file: " << ex.what() << endl;
                 return -1;
-			}
+            }
+        }
+
+        //Same as openE57 and streamE57, for any scan of the open session, in any order
+        inline int readScan(int64_t scanIndex, PtrXYZ &pointcloud, float &scale_factor, Eigen::Matrix4f& mat4, size_t blockSize = DEFAULT_BLOCK_SIZE, const DecodeOptions &options = DecodeOptions()){
+            pointcloud->clear();
+            if(!session_){
+                cout << "No E57 session open." << endl;
+                return -1;
+            }
+            int64_t scanCount;
+            int result = decodeScanInto(*session_, BlockCallback(), pointcloud.get(), scale_factor, scanCount, mat4, scanIndex, blockSize, options);
+            finishCloud(pointcloud);
+            return result;
+        }
+
+        inline int streamScan(int64_t scanIndex, const BlockCallback &onBlock, float &scale_factor, Eigen::Matrix4f& mat4, size_t blockSize = DEFAULT_BLOCK_SIZE, const DecodeOptions &options = DecodeOptions()){
+            if(!session_){
+                cout << "No E57 session open." << endl;
+                return -1;
+            }
+            int64_t scanCount;
+            return decodeScan(*session_, onBlock, scale_factor, scanCount, mat4, scanIndex, blockSize, options);
+        }
+
+        //Decodes several scans of the open session at once, on up to threadCount threads (0 is one per core).
+        //A scan isn't started while its block buffers plus those of the scans in progress would go over
+        //memoryLimit bytes (0 is no limit). onBlock is called on the decoding threads, concurrently for
+        //different scans, but never concurrently for the same scan.
+        //results[i] is filled for scanIndexes[i]. Returns the lowest result of all scans (1 if all were read),
+        //or -1 if no session is open.
+        inline int streamScans(const std::vector<int64_t> &scanIndexes, const ScanBlockCallback &onBlock, ScanResults &results, unsigned threadCount = 0, uint64_t memoryLimit = 0, size_t blockSize = DEFAULT_BLOCK_SIZE, const DecodeOptions &options = DecodeOptions()){
+            return decodeScans(scanIndexes, [&scanIndexes, &onBlock](size_t i) -> BlockCallback {
+                int64_t scanIndex = scanIndexes[i];
+                return [&onBlock, scanIndex](const pcl::PointCloud<P_XYZ> &block, int64_t totalPoints){
+                    onBlock(scanIndex, block, totalPoints);
+                };
+            }, NULL, results, threadCount, memoryLimit, blockSize, options);
+        }
+
+        //Same as streamScans, loading scan scanIndexes[i] into clouds[i].
+        //Points are decoded straight into the clouds, so memoryLimit only covers the readers' packet buffers.
+        inline int readScans(const std::vector<int64_t> &scanIndexes, std::vector<PtrXYZ> &clouds, ScanResults &results, unsigned threadCount = 0, uint64_t memoryLimit = 0, size_t blockSize = DEFAULT_BLOCK_SIZE, const DecodeOptions &options = DecodeOptions()){
+            clouds.resize(scanIndexes.size());
+            for(size_t i = 0; i < clouds.size(); i++){
+                if(!clouds[i])
+                    clouds[i].reset(new pcl::PointCloud<P_XYZ>);
+                clouds[i]->clear();
+            }
+            int result = decodeScans(scanIndexes, std::function<BlockCallback(size_t)>(), &clouds, results, threadCount, memoryLimit, blockSize, options);
+            for(size_t i = 0; i < clouds.size(); i++)
+                finishCloud(clouds[i]);
+            return result;
+        }
+
+        //Decodes scan scanIndex of an open file, see streamE57
+        inline int decodeScan(ImageFile &imf, const BlockCallback &onBlock, float &scale_factor, int64_t& scanCount, Eigen::Matrix4f& mat4, int64_t scanIndex = 0, size_t blockSize = DEFAULT_BLOCK_SIZE, const DecodeOptions &options = DecodeOptions()){
+            return decodeScanInto(imf, onBlock, NULL, scale_factor, scanCount, mat4, scanIndex, blockSize, options);
         }
 	
         inline int saveE57File(const std::string &filename, PtrXYZ &cloud, float &scale_factor, int index = 0){
@@ -340,51 +443,32 @@ class E57{
 	
 	    
 	        ///================
-	        /// Prepare vector of source buffers for writing in the CompressedVector of points
-	        int N = (int) cloud.get()->size();
+	        /// Write the CompressedVector of points straight from the cloud memory, a block at a time.
+	        /// The fields that are the same for every point come from block sized arrays shared by all blocks,
+	        /// and only a partial last block is copied, since the buffers can't change size between blocks.
+	        size_t N = cloud->size();
 	        cout<<"Number of point to write: "<<N<<endl;
-	        double *cartesianX = new double[N];
-	        double *cartesianY = new double[N];
-	        double *cartesianZ = new double[N];
-	        int32_t *cartesianInvalidState = new int32_t[N];
-	        int32_t *rowIndex = new int32_t[N];
-	        int32_t *columnIndex = new int32_t[N];
-	        int32_t *returnIndex = new int32_t[N];
-            int32_t *returnCount = new int32_t[N];
-            for (auto j = 0; j < N; j++)
-            {
-				cartesianX[j] = cloud->points[j].x;	
-				cartesianY[j] = cloud->points[j].y;	
-                cartesianZ[j] = cloud->points[j].z;
-				cartesianInvalidState[j] = 0;
-				rowIndex[j] = 0;
-				columnIndex[j] = 0;
-				returnIndex[j] = 0;
-				returnCount[j] = 1;
-			}
-	        std::vector<SourceDestBuffer> sourceBuffers;
-	        sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianX",  cartesianX,  N, true, true));
-	        sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianY",  cartesianY,  N, true, true));
-	        sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianZ",  cartesianZ,  N, true, true));
-	        sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianInvalidState", cartesianInvalidState, N, true));
-	        sourceBuffers.push_back(SourceDestBuffer(imf, "rowIndex",    rowIndex,    N, true));
-	        sourceBuffers.push_back(SourceDestBuffer(imf, "columnIndex", columnIndex, N, true));
-	        sourceBuffers.push_back(SourceDestBuffer(imf, "returnIndex", returnIndex, N, true));
-            sourceBuffers.push_back(SourceDestBuffer(imf, "returnCount", returnCount, N, true));
-			cout << "Source Buffers prepared"<< endl;
-	        /// Write source buffers into CompressedVector
+	        size_t blockSize = std::max<size_t>(std::min<size_t>(N, 1 << 16), 1);
+	        std::vector<int32_t> zeros(blockSize, 0), ones(blockSize, 1);
+	        pcl::PointCloud<P_XYZ> tail;
 	        {
+	            std::vector<SourceDestBuffer> sourceBuffers = pointSourceBuffers(imf, &cloud->points[0], blockSize, zeros, ones);
 	            CompressedVectorWriter writer = points.writer(sourceBuffers);
-	            writer.write(N);
+	            cout << "Source Buffers prepared"<< endl;
+	            for (size_t start = 0; start < N; start += blockSize)
+	            {
+	                size_t count = std::min(blockSize, N - start);
+	                P_XYZ *first = &cloud->points[start];
+	                if (count < blockSize)
+	                {
+	                    tail.resize(blockSize);
+	                    std::copy(cloud->points.begin() + start, cloud->points.end(), tail.points.begin());
+	                    first = &tail.points[0];
+	                }
+	                sourceBuffers = pointSourceBuffers(imf, first, blockSize, zeros, ones);
+	                writer.write(sourceBuffers, count);
+	            }
 	            writer.close();
-				delete[] cartesianX;
-	            delete[] cartesianY;
-	            delete[] cartesianZ;
-	            delete[] cartesianInvalidState;
-	            delete[] rowIndex;
-	            delete[] columnIndex;
-	            delete[] returnIndex;
-                delete[] returnCount;
 	        }
 	
 	        imf.close();
@@ -398,6 +482,226 @@ class E57{
 		
 		return 1;
 		}	
+
+	private:
+        //Open session, see openSession(); null when no file is open
+        std::shared_ptr<ImageFile> session_;
+        int64_t sessionScanCount_;
+
+        //Number of scans in the "/data3D" vector of imf, or -1 (after reporting it) if there is no such vector
+        inline int64_t countScans(ImageFile &imf){
+            StructureNode root = imf.root();
+            /// Make sure vector of scans is defined and of expected type.
+            /// If "/data3D" wasn't defined, the call to root.get below would raise an exception.
+            if (!root.isDefined("/data3D")) {
+                cout << "File doesn't contain 3D images."<<endl;
+                return -1;
+            }
+            Node n = root.get("/data3D");
+            if (n.type() != E57_VECTOR) {
+                cout <<"File Corrupted. Error during opening."<<endl;
+                return -1;
+            }
+            /// The node is a vector so we can safely get a VectorNode handle to it.
+            /// The number of its children is the number of scans in file.
+            return VectorNode(n).childCount();
+        }
+
+        //Common part of streamScans and readScans: decodes scanIndexes[i] into (*clouds)[i] if clouds isn't null,
+        //else with the callback from callbackFor(i)
+        inline int decodeScans(const std::vector<int64_t> &scanIndexes, const std::function<BlockCallback(size_t)> &callbackFor, std::vector<PtrXYZ> *clouds, ScanResults &results, unsigned threadCount, uint64_t memoryLimit, size_t blockSize, const DecodeOptions &options){
+            results.assign(scanIndexes.size(), ScanResult());
+            if(!session_){
+                cout << "No E57 session open." << endl;
+                return -1;
+            }
+            /// When streaming, each scan holds one block of points while it's decoded
+            /// and each reader decodes at most the POINT_CHANNELS fields of pointBuffers
+            uint64_t scanBytes = clouds ? 0 : (uint64_t)blockSize * sizeof(P_XYZ);
+
+            std::vector<ReadTask> tasks;
+            for(size_t i = 0; i < scanIndexes.size(); i++){
+                results[i].result = -1;
+                results[i].scale_factor = 1;
+                results[i].mat4 = Eigen::Matrix4f::Identity();
+                tasks.push_back(ReadTask([this, i, &scanIndexes, &callbackFor, clouds, &results, blockSize, &options](){
+                    ImageFile imf(*session_);
+                    int64_t scanCount;
+                    ScanResult &r = results[i];
+                    if(clouds)
+                        r.result = decodeScanInto(imf, BlockCallback(), (*clouds)[i].get(), r.scale_factor, scanCount, r.mat4, scanIndexes[i], blockSize, options);
+                    else
+                        r.result = decodeScan(imf, callbackFor(i), r.scale_factor, scanCount, r.mat4, scanIndexes[i], blockSize, options);
+                }, scanBytes, POINT_CHANNELS));
+            }
+            try{
+                session_->readConcurrently(tasks, threadCount, memoryLimit);
+            } catch(E57Exception& ex){
+                cout << "Error during reading file: " << ex.what() << endl;
+                return -1;
+            }
+
+            int result = 1;
+            for(size_t i = 0; i < results.size(); i++)
+                result = std::min(result, results[i].result);
+            return result;
+        }
+
+        //Opens filename just for decoding one scan, see openE57 and streamE57
+        inline int decodeFile(const std::string &filename, const BlockCallback &onBlock, pcl::PointCloud<P_XYZ> *cloud, float &scale_factor, int64_t& scanCount, Eigen::Matrix4f& mat4, int64_t scanIndex, size_t blockSize, const DecodeOptions &options){
+            try{
+                ImageFile imf(filename, "r");
+                int result = decodeScanInto(imf, onBlock, cloud, scale_factor, scanCount, mat4, scanIndex, blockSize, options);
+                imf.close();
+                return result;
+            } catch(E57Exception& ex){
+                cout << "Error during reading file: " << ex.what() << endl;
+                return -1;
+            }
+        }
+
+        //Decodes scan scanIndex of imf. Points are decoded straight into point memory, with strided buffers:
+        //into cloud (sized to the whole scan) if it isn't null, else into one block at a time handed to onBlock.
+        //Scaling and the pose of options are applied to each block right after it's decoded, in place.
+        inline int decodeScanInto(ImageFile &imf, const BlockCallback &onBlock, pcl::PointCloud<P_XYZ> *cloud, float &scale_factor, int64_t& scanCount, Eigen::Matrix4f& mat4, int64_t scanIndex, size_t blockSize, const DecodeOptions &options){
+			try{
+				int64_t count = countScans(imf);
+				if (count < 0)
+					return 0;
+				scanCount = count;
+				VectorNode data3D(imf.root().get("/data3D"));
+				
+				if(scanCount == 0 || scanIndex < 0 || scanIndex >= scanCount || blockSize == 0){
+					cout <<"File doesn't contain valid informations."<<endl;
+					return 0;
+				}
+				
+				/// Get scan from "/data3D", assume its a Structure (else get exception)
+				StructureNode scan(data3D.get(scanIndex));
+
+				StructureNode pose(scan.get("pose"));
+				StructureNode rotation(pose.get("rotation"));
+				StructureNode translation(pose.get("translation"));
+				float rx = FloatNode(rotation.get("x")).value();
+				float ry = FloatNode(rotation.get("y")).value();
+				float rz = FloatNode(rotation.get("z")).value();
+				float rw = FloatNode(rotation.get("w")).value();
+				float tx = FloatNode(translation.get("x")).value();
+				float ty = FloatNode(translation.get("y")).value();
+				float tz = FloatNode(translation.get("z")).value();
+
+				Eigen::Matrix3f mat3 = Eigen::Quaternionf(rw, rx, ry, rz).toRotationMatrix();
+				mat4 = Eigen::Matrix4f::Identity();
+				mat4.block(0,0,3,3) = mat3;
+				mat4.block(0,3,3,1) = Eigen::Vector3f(tx, ty, tz);
+
+				/// Get "points" field in scan.  Should be a CompressedVectorNode.
+				CompressedVectorNode points(scan.get("points"));
+				int64_t totalPoints = points.childCount();
+
+				StructureNode proto(points.prototype());
+
+				/// One unit scale for the whole scan, known up front unless it has to be sampled from the first block
+				float unitScale = options.unitScale > 0 ? options.unitScale : prototypeUnitScale(proto);
+				if(unitScale == 0)
+					unitScale = options.guessUnit ? boundsUnitScale(scan) : 1;
+			    /// The prototype should have a field named either "cartesianX" or "sphericalRange".
+                if (proto.isDefined("cartesianX") && proto.isDefined("cartesianY") && proto.isDefined("cartesianZ")) {
+                    /// Never allocate more than the scan holds
+                    if(totalPoints < (int64_t)blockSize)
+                        blockSize = (size_t)std::max<int64_t>(totalPoints, 1);
+
+			        /// Decode straight into the points, no intermediate xyz arrays and no copying afterwards.
+			        /// Either cloud is sized to the whole scan and filled in one go, or block holds one block at a time.
+                    pcl::PointCloud<P_XYZ> block;
+                    pcl::PointCloud<P_XYZ> &dest = cloud ? *cloud : block;
+                    size_t capacity = cloud ? (size_t)std::max<int64_t>(totalPoints, 1) : blockSize;
+                    dest.resize(capacity);
+
+			        /// Create a reader of the points CompressedVector.
+			        /// Each call to reader.read() fills the points with the next block, until the points are exhausted.
+                    CompressedVectorReader reader = points.reader(pointBuffers(imf, &dest.points[0], capacity, proto.isDefined("intensity")));
+                    Eigen::Matrix4f placement;
+                    bool place = false;
+                    int64_t pointsRead = 0;
+                    unsigned gotCount;
+                    while((gotCount = reader.read()) > 0)
+                    {
+                        P_XYZ *first = &dest.points[cloud ? (size_t)pointsRead : 0];
+                        if(pointsRead == 0)
+                        {
+                            if(unitScale == 0)
+                                unitScale = sampledUnitScale(first, gotCount);
+                            /// Scale and pose folded into one affine map, so each point is moved by a single multiply-add pass
+                            placement = options.applyPose ? mat4 : Eigen::Matrix4f::Identity();
+                            placement.block(0,0,3,3) *= unitScale;
+                            place = !placement.isIdentity(0);
+                        }
+                        if(place)
+                            placePoints(first, gotCount, placement);
+                        if(!cloud)
+                        {
+                            block.resize(gotCount);
+                            onBlock(block, totalPoints);
+                        }
+                        pointsRead += gotCount;
+                    }
+                    if(cloud)
+                        cloud->resize((size_t)pointsRead);
+                    if(pointsRead == 0 && totalPoints > 0)
+                    {
+                        cout << "Failed to read E57 file" << endl;
+                        return -1;
+                    }
+					scale_factor = unitScale > 0 ? unitScale : 1;	//nothing was read from an empty scan to sample
+					reader.close();
+					return 1;
+				}
+				else {
+					cout<<"Error during reading file."<<endl;
+				
+					return 0;
+				}
+				
+			} catch(E57Exception& ex){
+                cout << "Error during reading file: " << ex.what() << endl;
+                return -1;
+			}
+        }
+	
+
+        //Most buffers pointBuffers gives a reader: x, y, z and intensity
+        static const unsigned POINT_CHANNELS = 4;
+
+        //Buffers that read the xyz (and intensity) fields of count points straight into (or write them from) the
+        //points starting at first, stepping sizeof(P_XYZ) bytes from point to point.
+        //All fields are scaled, so ScaledInteger xyz are read and written as real values.
+        static inline vector<SourceDestBuffer> pointBuffers(ImageFile &imf, P_XYZ *first, size_t count, bool hasIntensity){
+            vector<SourceDestBuffer> buffers;
+            buffers.push_back(SourceDestBuffer(imf, "cartesianX", &first->x, count, true, true, sizeof(P_XYZ)));
+            buffers.push_back(SourceDestBuffer(imf, "cartesianY", &first->y, count, true, true, sizeof(P_XYZ)));
+            buffers.push_back(SourceDestBuffer(imf, "cartesianZ", &first->z, count, true, true, sizeof(P_XYZ)));
+            if(hasIntensity)
+                buffers.push_back(SourceDestBuffer(imf, "intensity", &first->intensity, count, true, true, sizeof(P_XYZ)));
+            return buffers;
+        }
+
+        //Source buffers for the fields saveE57File writes, the constant ones taken from zeros and ones
+        static inline vector<SourceDestBuffer> pointSourceBuffers(ImageFile &imf, P_XYZ *first, size_t count, std::vector<int32_t> &zeros, std::vector<int32_t> &ones){
+            vector<SourceDestBuffer> buffers = pointBuffers(imf, first, count, false);
+            buffers.push_back(SourceDestBuffer(imf, "cartesianInvalidState", &zeros[0], count, true));
+            buffers.push_back(SourceDestBuffer(imf, "rowIndex",    &zeros[0], count, true));
+            buffers.push_back(SourceDestBuffer(imf, "columnIndex", &zeros[0], count, true));
+            buffers.push_back(SourceDestBuffer(imf, "returnIndex", &zeros[0], count, true));
+            buffers.push_back(SourceDestBuffer(imf, "returnCount", &ones[0],  count, true));
+            return buffers;
+        }
+
+        static inline void finishCloud(PtrXYZ &pointcloud){
+            pointcloud->width = pointcloud->points.size();
+            pointcloud->height = 1;
+            pointcloud->is_dense = false;
+        }
 };
 
 		
@@ -2,33 +2,330 @@
 
 #include <iostream>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+#ifdef LINUX
+#include <glob.h>
+#include <unistd.h>
+#endif
 
 #include <pcl/io/pcd_io.h>
-#include <pcl/common/transforms.h>
 
 #include "e57.h"
+#include "pcd_stream.h"
+#include "downsample.h"
 
 using namespace std;
 using namespace e57;
 
+enum PCDFormat { PCD_ASCII, PCD_BINARY, PCD_BINARY_COMPRESSED };
+
+struct Options{
+	PCDFormat format;
+	bool stream;
+	bool writeBack;
+	unsigned threads;		//0 is one per core
+	uint64_t memoryLimit;	//bytes, 0 is no limit
+	float voxelSize;		//meters, 0 is no voxel grid
+	double sampleFraction;	//fraction of the points kept at random, 1 keeps them all
+	float unitScale;		//multiplies xyz into meters, 0 takes it from the file
+	bool guessUnit;			//guess the unit from the span of each scan when the file doesn't tell it
+
+	bool downsamples() const { return voxelSize > 0 || sampleFraction < 1; }
+};
+
+// Memory of the whole machine, 0 if it can't be told
+uint64_t physicalMemory()
+{
+#ifdef LINUX
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long pageSize = sysconf(_SC_PAGE_SIZE);
+	if(pages > 0 && pageSize > 0)
+		return (uint64_t)pages * (uint64_t)pageSize;
+#endif
+	return 0;
+}
+
+// Options: -format ascii|binary|binary_compressed (default ascii)
+//          -stream, writes binary PCD block by block as the scan is decoded, without loading the whole scan
+//                   (not with -voxel or -sample)
+//          -threads N, number of scans converted at once (default one per core)
+//          -memory MB, scans aren't started while the ones in progress would take more (default half the RAM)
+//          -writeback, also writes each converted cloud back to Scan-<file>-<scan>.e57
+//          -voxel M, merges the points of each M meters cube into their centroid, while the scan is decoded
+//          -sample F, keeps each point with probability F (before the voxel grid, if both are given)
+//          -unit S|auto, multiplies xyz by S (e.g. 0.001 for millimeters), or with auto guesses from the extent of
+//                        each scan whose file doesn't tell the unit. Default is meters unless the file says otherwise
+int loadOptions(int argc, char **argv, Options &options)
+{
+	options.format = PCD_ASCII;
+	options.stream = false;
+	options.writeBack = false;
+	options.threads = 0;
+	options.memoryLimit = physicalMemory() / 2;
+	options.voxelSize = 0;
+	options.sampleFraction = 1;
+	options.unitScale = 0;
+	options.guessUnit = false;
+    for (int i = 1; i < argc; ++i)
+	{
+		std::string option = std::string (argv[i]);
+		if(option == "-stream")
+			options.stream = true;
+		else if(option == "-writeback")
+			options.writeBack = true;
+		else if(option == "-threads" && i + 1 < argc)
+			options.threads = (unsigned)atoi(argv[++i]);
+		else if(option == "-memory" && i + 1 < argc)
+			options.memoryLimit = (uint64_t)atoll(argv[++i]) << 20;
+		else if(option == "-voxel" && i + 1 < argc)
+			options.voxelSize = (float)atof(argv[++i]);
+		else if(option == "-sample" && i + 1 < argc)
+			options.sampleFraction = atof(argv[++i]);
+		else if(option == "-unit" && i + 1 < argc)
+		{
+			std::string value = std::string (argv[++i]);
+			if(value == "auto")
+				options.guessUnit = true;
+			else if((options.unitScale = (float)atof(value.c_str())) <= 0)
+			{
+				cout << "-unit needs a positive scale or auto" << endl;
+				return 0;
+			}
+		}
+		else if(option == "-format" && i + 1 < argc)
+		{
+			std::string value = std::string (argv[++i]);
+			if(value == "ascii")
+				options.format = PCD_ASCII;
+			else if(value == "binary")
+				options.format = PCD_BINARY;
+			else if(value == "binary_compressed")
+				options.format = PCD_BINARY_COMPRESSED;
+			else
+			{
+				cout << "Unknown PCD format: " << value << endl;
+				return 0;
+			}
+		}
+	}
+	if(options.stream && options.format != PCD_BINARY)
+	{
+		// binary_compressed stores each field of all the points together, so it needs the whole cloud
+		cout << "-stream needs -format binary" << endl;
+		return 0;
+	}
+	if(options.sampleFraction <= 0 || options.sampleFraction > 1 || options.voxelSize < 0)
+	{
+		cout << "-sample needs a fraction in (0, 1], -voxel a positive size" << endl;
+		return 0;
+	}
+	if(options.stream && options.downsamples())
+	{
+		// Downsampling has to see every point before it writes any, so it can't stream to the file
+		cout << "-stream can't be used with -voxel or -sample" << endl;
+		return 0;
+	}
+	if(options.stream && options.writeBack)
+	{
+		cout << "-writeback needs the whole cloud, it can't be used with -stream" << endl;
+		return 0;
+	}
+	if(options.threads == 0)
+		options.threads = std::max(std::thread::hardware_concurrency(), 1u);
+	return 1;
+}
+
+int savePCD(const std::string &filename, const pcl::PointCloud<P_XYZ> &cloud, PCDFormat format)
+{
+	switch(format)
+	{
+		case PCD_BINARY:
+			return pcl::io::savePCDFileBinary (filename, cloud);
+		case PCD_BINARY_COMPRESSED:
+			return pcl::io::savePCDFileBinaryCompressed (filename, cloud);
+		default:
+			return pcl::io::savePCDFileASCII (filename, cloud);
+	}
+}
+
+// Adds fname to files, or the files it matches if it is a pattern such as scans/*.e57
+void addFiles(const std::string &fname, vector<string> &files)
+{
+#ifdef LINUX
+	if(fname.find_first_of("*?[") != std::string::npos)
+	{
+		glob_t matches;
+		if(glob(fname.c_str(), 0, NULL, &matches) == 0)
+		{
+			for(size_t i = 0; i < matches.gl_pathc; ++i)
+				files.push_back(matches.gl_pathv[i]);
+		}
+		else
+			cout << "No file matches " << fname << endl;
+		globfree(&matches);
+		return;
+	}
+#endif
+	files.push_back(fname);
+}
+
 int loadData(int argc, char **argv, vector<string> &files)
 {
 	std::string extension (".e57");
-	// Suppose the first argument is the actual test model
+	// Every argument that isn't an option is a file, or a pattern of files
     for (int i = 1; i < argc; ++i)
 	{
 		std::string fname = std::string (argv[i]);
-		cout << fname <<endl;
-		files.push_back(fname);	 
-		return 1;
+		// Options are read by loadOptions
+		if(fname == "-format" || fname == "-threads" || fname == "-memory" || fname == "-voxel" || fname == "-sample")
+		{
+			++i;
+			continue;
+		}
+		if(fname == "-stream" || fname == "-writeback")
+			continue;
+		addFiles(fname, files);
 	}
-    return 0;
+	for(size_t i = 0; i < files.size(); ++i)
+		cout << files[i] << endl;
+    return files.empty() ? 0 : 1;
+}
+
+// Bytes of the jobs in progress. A job waits until its bytes fit in the limit,
+// except when nothing else is running, so a job bigger than the limit still runs, alone.
+class JobBudget{
+	private:
+		std::mutex mutex_;
+		std::condition_variable released_;
+		uint64_t limit_;
+		uint64_t used_;
+		unsigned holders_;
+
+	public:
+		JobBudget(uint64_t limit) : limit_(limit), used_(0), holders_(0) {}
+
+		void acquire(uint64_t bytes){
+			std::unique_lock<std::mutex> lock(mutex_);
+			released_.wait(lock, [this, bytes]{ return limit_ == 0 || holders_ == 0 || used_ + bytes <= limit_; });
+			used_ += bytes;
+			holders_++;
+		}
+
+		void release(uint64_t bytes){
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				used_ -= bytes;
+				holders_--;
+			}
+			released_.notify_all();
+		}
+};
+
+// Files whose survey session is left open for their jobs. Past that many, a file is closed once
+// surveyed and parsed again by its first job, so a big batch doesn't hold a handle per file.
+const size_t MAX_SURVEYED_SESSIONS = 64;
+
+// One E57 file of the batch. Its session is opened by the survey, kept for the first of its jobs
+// if few enough files are open (or else opened again by it), and closed by the last one to finish.
+struct FileState{
+	std::string name;
+	std::mutex mutex;
+	E57 e57;
+	int64_t pending;
+	bool failed;
+};
+
+// Conversion of one scan of one file
+struct Job{
+	size_t fileIndex;
+	int64_t scanIndex;
+	int64_t points;
+	uint64_t memory;	//what the job holds at its peak, charged to the JobBudget
+};
+
+// Converts one scan to Scan-<fileIndex>-<scanIndex>.pcd. Returns the number of points written, or -1.
+// Errors and warnings go to messages, which the caller prints with its report of the scan.
+int64_t convertScan(FileState &file, const Job &job, const Options &options, std::ostream &messages)
+{
+	std::stringstream ss;
+	ss << "Scan-" << job.fileIndex << "-" << job.scanIndex << ".pcd";
+
+	// Points come out already moved by the scan pose, no second cloud to transform into
+	float scale_factor = 0;
+	Eigen::Matrix4f matrix;
+	PtrXYZ cloud(new pcl::PointCloud<P_XYZ>);
+	if(options.downsamples()){
+		// Blocks are downsampled as they are decoded, only the downsampled cloud is ever held
+		StreamingDownsampler downsampler(options.voxelSize, options.sampleFraction);
+		int result = file.e57.streamScan(job.scanIndex, [&downsampler](const pcl::PointCloud<P_XYZ> &block, int64_t){
+			downsampler.add(block);
+		}, scale_factor, matrix, E57::DEFAULT_BLOCK_SIZE, E57::DecodeOptions(true, options.unitScale, options.guessUnit));
+		if(result == -1){
+			messages << "Error reading file" << endl;
+			return -1;
+		}
+		// Like pcl::VoxelGrid, a leaf too small for the coordinates is only warned about
+		if(downsampler.pointsOutOfRange() > 0)
+			messages << "Warning: -voxel " << options.voxelSize << " is too small for " << downsampler.pointsOutOfRange()
+				 << " points of " << ss.str() << ", their voxel indices would overflow and they were dropped" << endl;
+		downsampler.finish(*cloud);
+	}
+	else if(options.stream){
+		// Each decoded block goes straight to the file, the scan is never in memory as a whole
+		PCDStreamWriter writer;
+		int written = 1;
+		int result = file.e57.streamScan(job.scanIndex, [&](const pcl::PointCloud<P_XYZ> &block, int64_t totalPoints){
+			if(written == 1 && !writer.isOpen())
+				written = writer.open(ss.str(), totalPoints);
+			if(written == 1)
+				written = writer.append(block);
+		}, scale_factor, matrix, E57::DEFAULT_BLOCK_SIZE, E57::DecodeOptions(true, options.unitScale, options.guessUnit));
+		if(result == -1){
+			messages << "Error reading file" << endl;
+			return -1;
+		}
+		// An empty scan never calls back
+		if(written == 1 && !writer.isOpen())
+			written = writer.open(ss.str(), 0);
+		if(written == -1 || writer.close() == -1){
+			messages << "Error saving " << ss.str() << endl;
+			return -1;
+		}
+		return (int64_t)writer.pointsWritten();
+	}
+	else if(file.e57.readScan(job.scanIndex, cloud, scale_factor, matrix, E57::DEFAULT_BLOCK_SIZE, E57::DecodeOptions(true, options.unitScale, options.guessUnit)) == -1){
+		messages << "Error reading file" << endl;
+		return -1;
+	}
+	if(savePCD(ss.str(), *cloud, options.format) < 0){
+		messages << "Error saving " << ss.str() << endl;
+		return -1;
+	}
+
+	//demonstration of writing down from PCD to E57
+	if(options.writeBack && !cloud->empty()){
+		std::stringstream e57Name;
+		e57Name << "Scan-" << job.fileIndex << "-" << job.scanIndex << ".e57";
+		if(file.e57.saveE57File(e57Name.str(), cloud, scale_factor) == 0){
+			messages << "Error saving in e57"<<endl;
+			return -1;
+		}
+	}
+	return (int64_t)cloud->size();
 }
 
 int main (int argc, char** argv){
-	
+
     vector<string> filenames;
-    E57 e57;
+    Options options;
+    if(!loadOptions(argc, argv, options))
+		return (-1);
     loadData(argc, argv, filenames);
 	// Check user input
 	if (filenames.empty ())
@@ -36,46 +333,117 @@ int main (int argc, char** argv){
 		cout << "Error checking files"<<endl;
 		return (-1);
 	}
- 
-    PtrXYZ cloud(new pcl::PointCloud<P_XYZ>);
-    PtrXYZ cloud_transformed(new pcl::PointCloud<P_XYZ>);
-	
-    float scale_factor = 0;
+
+	// Survey the files for their scans and sizes, so that jobs can be charged to the memory budget.
+	// Jobs are taken in file order, so the sessions kept open are of the files converted first.
+	std::vector<std::unique_ptr<FileState> > files;
+	size_t openSessions = 0;
+	std::vector<Job> jobs;
+	int failures = 0;
     for(size_t i = 0; i < filenames.size(); ++i)
     {
-		// Will be overwritten:
-		int64_t scanCount = 1;
-
+		files.push_back(std::unique_ptr<FileState>(new FileState));
+		FileState &file = *files.back();
+		file.name = filenames.at(i);
+		file.pending = 0;
+		file.failed = false;
+		int64_t scanCount = file.e57.openSession(file.name);
+		if(scanCount == -1){
+			cout << "Error reading file " << file.name << endl;
+			failures++;
+			continue;
+		}
 		for (int64_t scanIndex = 0; scanIndex < scanCount; ++ scanIndex) {
-			Eigen::Matrix4f matrix;
-			if(e57.openE57(filenames.at(i), cloud, scale_factor, scanCount, matrix, scanIndex) == -1){
-				cout << "Error reading file" << endl;
-				return -1;
+			Job job;
+			job.fileIndex = i;
+			job.scanIndex = scanIndex;
+			job.points = std::max<int64_t>(file.e57.sessionScanPoints(scanIndex), 0);
+			// A streamed scan holds a decoded block and its packed copy, a loaded one the whole cloud
+			// and about as much again while pcl formats it. A downsampled one holds a decoded block,
+			// and at most the sampled points in its output (voxel sums take about twice a point).
+			int64_t blockPoints = std::min<int64_t>(job.points, E57::DEFAULT_BLOCK_SIZE);
+			if(options.downsamples()){
+				uint64_t outputPoints = (uint64_t)std::ceil(job.points * options.sampleFraction);
+				job.memory = (uint64_t)blockPoints * sizeof(P_XYZ) + outputPoints * sizeof(P_XYZ) * (options.voxelSize > 0 ? 4 : 2);
 			}
+			else
+				job.memory = (uint64_t)(options.stream ? blockPoints : job.points) * sizeof(P_XYZ) * 2;
+			jobs.push_back(job);
+			file.pending++;
+		}
+		if(file.pending > 0 && openSessions < MAX_SURVEYED_SESSIONS)
+			openSessions++;
+		else
+			file.e57.closeSession();
+	}
+
+	// Scans of all files are converted on a pool of threads, taking jobs in file order
+	// so that few files are open at once
+	JobBudget budget(options.memoryLimit);
+	std::mutex reportMutex;
+	std::atomic<size_t> nextJob(0);
+	std::atomic<int64_t> totalPoints(0);
+	std::atomic<int> failedJobs(0);
+	auto batchStart = std::chrono::steady_clock::now();
 
-			pcl::transformPointCloud (*cloud, *cloud_transformed, matrix);
-		
-			std::stringstream ss;
-			ss << "Scan-" << i << "-" << scanIndex << ".pcd";
-			cout << ss.str() << endl;
-			int n = 0;
-			
-			pcl::io::savePCDFileASCII (ss.str(), *cloud_transformed);
-
-			//demonstration of writing down from PCD to E57
-			if(e57.saveE57File("test.e57", cloud, scale_factor) == -1){
-				cout << "Error saving in e57"<<endl;
-				return -1;
+	auto worker = [&](){
+		for(size_t j = nextJob++; j < jobs.size(); j = nextJob++){
+			const Job &job = jobs[j];
+			FileState &file = *files[job.fileIndex];
+			budget.acquire(job.memory);
+			bool opened;
+			{
+				std::lock_guard<std::mutex> lock(file.mutex);
+				if(!file.failed && !file.e57.isSessionOpen() && file.e57.openSession(file.name) == -1)
+					file.failed = true;
+				opened = !file.failed;
 			}
+			auto start = std::chrono::steady_clock::now();
+			std::stringstream messages;
+			int64_t points = opened ? convertScan(file, job, options, messages) : -1;
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			{
+				std::lock_guard<std::mutex> lock(file.mutex);
+				if(--file.pending == 0)
+					file.e57.closeSession();
+			}
+			budget.release(job.memory);
 
+			std::lock_guard<std::mutex> lock(reportMutex);
+			cout << messages.str();
+			if(points < 0){
+				failedJobs++;
+				cout << "FAILED: \t" << file.name << " scan " << job.scanIndex << endl;
+				continue;
+			}
+			// Throughput is of the points decoded, which downsampling doesn't all write
+			totalPoints += job.points;
+			double megabytes = (double)job.points * 4 * sizeof(float) / (1 << 20);	//x y z intensity
 			cout << "********************* CONVERSION COMPLETED *********************"<<endl;
-			cout << "File: \t" << filenames.at(i) << endl;
-			cout << "Cloud Size: \t" << cloud.get()->size() << endl;
-			cout << "File Saved: \t"<< ss.str() <<endl;
+			cout << "File: \t" << file.name << endl;
+			cout << "Scan: \t" << job.scanIndex << endl;
+			cout << "Cloud Size: \t" << points << endl;
+			cout << "File Saved: \t" << "Scan-" << job.fileIndex << "-" << job.scanIndex << ".pcd" << endl;
+			if(seconds > 0)
+				cout << "Throughput: \t" << job.points / seconds << " points/s, " << megabytes / seconds << " MB/s" << endl;
 			cout << "********************* CONVERSION COMPLETED *********************"<<endl;
 		}
-	}
-	
-    cout << "Conversion completed" << endl;
-	return 0;
+	};
+
+	unsigned threadCount = (unsigned)std::max<size_t>(std::min<size_t>(options.threads, jobs.size()), 1);
+	std::vector<std::thread> pool;
+	for(unsigned t = 1; t < threadCount; ++t)
+		pool.push_back(std::thread(worker));
+	worker();
+	for(size_t t = 0; t < pool.size(); ++t)
+		pool[t].join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+	failures += failedJobs;
+    cout << "Conversion completed: " << jobs.size() - failedJobs << " of " << jobs.size() << " scans, "
+         << totalPoints << " points decoded";
+	if(seconds > 0)
+		cout << ", " << totalPoints / seconds << " points/s";
+	cout << endl;
+	return failures == 0 ? 0 : -1;
 }
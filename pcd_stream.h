@@ -0,0 +1,103 @@
+#ifndef PCD_STREAM_H
+#define PCD_STREAM_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//Writes a binary PCD file of pcl::PointXYZI a block at a time, so the cloud never has to be in memory as a whole.
+//The header carries the point count given to open(), the blocks appended must add up to it.
+//Records are packed x y z intensity floats, as pcl::io::savePCDFileBinary writes them, so PCL reads the file back.
+class PCDStreamWriter{
+
+	private:
+		std::ofstream out_;
+		std::string filename_;
+		uint64_t declared_;
+		uint64_t written_;
+		std::vector<float> packed_;	//one block of records, reused from block to block
+
+	public:
+		PCDStreamWriter() : declared_(0), written_(0) {}
+		~PCDStreamWriter(){ close(); }
+
+		inline bool isOpen() const { return out_.is_open(); }
+		inline uint64_t pointsWritten() const { return written_; }
+
+		//Creates filename and writes the header for pointCount points. Returns 1, or -1 if the file can't be written.
+		inline int open(const std::string &filename, uint64_t pointCount){
+			close();
+			out_.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+			if(!out_){
+				std::cout << "Error opening PCD file: " << filename << std::endl;
+				return -1;
+			}
+			filename_ = filename;
+			declared_ = pointCount;
+			written_ = 0;
+
+			std::ostringstream header;
+			header << "# .PCD v0.7 - Point Cloud Data file format\n"
+			       << "VERSION 0.7\n"
+			       << "FIELDS x y z intensity\n"
+			       << "SIZE 4 4 4 4\n"
+			       << "TYPE F F F F\n"
+			       << "COUNT 1 1 1 1\n"
+			       << "WIDTH " << pointCount << "\n"
+			       << "HEIGHT 1\n"
+			       << "VIEWPOINT 0 0 0 1 0 0 0\n"
+			       << "POINTS " << pointCount << "\n"
+			       << "DATA binary\n";
+			const std::string text = header.str();
+			out_.write(text.data(), text.size());
+			return out_ ? 1 : -1;
+		}
+
+		//Appends the points of block after those already written, with a single write
+		inline int append(const pcl::PointCloud<pcl::PointXYZI> &block){
+			if(!out_.is_open())
+				return -1;
+			size_t count = block.points.size();
+			if(written_ + count > declared_){
+				std::cout << "Too many points for PCD file: " << filename_ << std::endl;
+				return -1;
+			}
+			packed_.resize(count * 4);
+			float *record = packed_.empty() ? NULL : &packed_[0];
+			for(size_t j = 0; j < count; j++, record += 4){
+				const pcl::PointXYZI &point = block.points[j];
+				record[0] = point.x;
+				record[1] = point.y;
+				record[2] = point.z;
+				record[3] = point.intensity;
+			}
+			if(count > 0)
+				out_.write(reinterpret_cast<const char*>(&packed_[0]), count * 4 * sizeof(float));
+			written_ += count;
+			return out_ ? 1 : -1;
+		}
+
+		//Closes the file. Returns 1, or -1 if writing failed or fewer points than declared were appended,
+		//which leaves a file PCL won't read. Does nothing (and returns 1) if no file is open.
+		inline int close(){
+			if(!out_.is_open())
+				return 1;
+			out_.close();
+			if(out_.fail()){
+				std::cout << "Error writing PCD file: " << filename_ << std::endl;
+				return -1;
+			}
+			if(written_ != declared_){
+				std::cout << "PCD file " << filename_ << " has " << written_ << " of its " << declared_ << " points" << std::endl;
+				return -1;
+			}
+			return 1;
+		}
+};
+
+#endif